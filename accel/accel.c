@@ -0,0 +1,219 @@
+#include "accel.h"
+#include <stdio.h>
+#include <string.h>
+
+static void create_bvh_accel(Accel* accel, Triangle* triangles, size_t count, BVHBuilder builder) {
+    accel->bvh = create_bvh_with_builder(triangles, count, builder);
+}
+
+static void rebuild_bvh_accel(Accel* accel, BVHBuilder builder) {
+    rebuild_bvh(&accel->bvh, builder);
+}
+
+static void copy_bvh_accel(const Accel* accel, Accel* copy, Triangle* triangles) {
+    copy->bvh = copy_bvh(&accel->bvh, triangles);
+}
+
+static void complete_bvh_accel(Accel* accel) {
+    complete_bvh(&accel->bvh);
+}
+
+static void destroy_bvh_accel(Accel* accel) {
+    destroy_bvh(&accel->bvh);
+}
+
+static bool intersect_bvh_accel(const Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    return intersect_bvh(&accel->bvh, ray, t_out, u_out, v_out, tri_idx);
+}
+
+static bool occluded_bvh_accel(const Accel* accel, Ray ray, float max_distance) {
+    return occluded_bvh(&accel->bvh, ray, max_distance);
+}
+
+static AABB get_bvh_accel_bounds(const Accel* accel) {
+    return accel->bvh.root ? accel->bvh.root->bounds : create_empty_aabb();
+}
+
+static AccelStats get_bvh_accel_stats(const Accel* accel) {
+    return (AccelStats){
+        accel->bvh.node_count,
+        accel->bvh.triangle_count,
+        accel->bvh.node_count * sizeof(BVHNode)
+    };
+}
+
+static void create_grid_accel(Accel* accel, Triangle* triangles, size_t count, BVHBuilder builder) {
+    (void)builder;
+    accel->grid = create_grid(triangles, count);
+}
+
+static void rebuild_grid_accel(Accel* accel, BVHBuilder builder) {
+    (void)builder;
+    rebuild_grid(&accel->grid);
+}
+
+static void copy_grid_accel(const Accel* accel, Accel* copy, Triangle* triangles) {
+    copy->grid = copy_grid(&accel->grid, triangles);
+}
+
+// Grids are fully built up front
+static void complete_grid_accel(Accel* accel) {
+    (void)accel;
+}
+
+static void destroy_grid_accel(Accel* accel) {
+    destroy_grid(&accel->grid);
+}
+
+static bool intersect_grid_accel(const Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    return intersect_grid(&accel->grid, ray, t_out, u_out, v_out, tri_idx);
+}
+
+static bool occluded_grid_accel(const Accel* accel, Ray ray, float max_distance) {
+    return occluded_grid(&accel->grid, ray, max_distance);
+}
+
+static AABB get_grid_accel_bounds(const Accel* accel) {
+    return accel->grid.triangle_count > 0 ? accel->grid.bounds : create_empty_aabb();
+}
+
+static AccelStats get_grid_accel_stats(const Accel* accel) {
+    return (AccelStats){
+        accel->grid.cell_count,
+        accel->grid.reference_count,
+        (accel->grid.cell_count + 1 + accel->grid.reference_count) * sizeof(int)
+    };
+}
+
+// Built from resident triangles, e.g. to compare backends, pages go to an unlinked temporary file
+static void create_paged_accel_data(Accel* accel, Triangle* triangles, size_t count, BVHBuilder builder) {
+    accel->paged = create_paged_geometry(triangles, count, builder, PAGED_DEFAULT_BUDGET);
+}
+
+static void rebuild_paged_accel(Accel* accel, BVHBuilder builder) {
+    (void)accel;
+    (void)builder;
+    fprintf(stderr, "Paged geometry is read-only, page the mesh out again after modifying it\n");
+}
+
+static void copy_paged_accel(const Accel* accel, Accel* copy, Triangle* triangles) {
+    (void)triangles;
+    copy->paged = accel->paged ? retain_paged_geometry(accel->paged) : NULL;
+}
+
+// Pages are complete BVH subtrees
+static void complete_paged_accel(Accel* accel) {
+    (void)accel;
+}
+
+static void destroy_paged_accel(Accel* accel) {
+    release_paged_geometry(accel->paged);
+    accel->paged = NULL;
+}
+
+static bool intersect_paged_accel(const Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    return accel->paged && intersect_paged_geometry(accel->paged, ray, t_out, u_out, v_out, tri_idx);
+}
+
+static bool occluded_paged_accel(const Accel* accel, Ray ray, float max_distance) {
+    return accel->paged && occluded_paged_geometry(accel->paged, ray, max_distance);
+}
+
+static AABB get_paged_accel_bounds(const Accel* accel) {
+    return accel->paged ? accel->paged->top_nodes[0].bounds : create_empty_aabb();
+}
+
+static AccelStats get_paged_accel_stats(const Accel* accel) {
+    if (!accel->paged) return (AccelStats){0, 0, 0};
+    return (AccelStats){
+        get_paged_geometry_node_count(accel->paged),
+        accel->paged->header.triangle_count,
+        get_paged_geometry_memory(accel->paged)
+    };
+}
+
+static const AccelBackend accel_backends[ACCEL_TYPE_COUNT] = {
+    [ACCEL_BVH] = {
+        "bvh", create_bvh_accel, rebuild_bvh_accel, copy_bvh_accel, complete_bvh_accel, destroy_bvh_accel,
+        intersect_bvh_accel, occluded_bvh_accel, get_bvh_accel_bounds, get_bvh_accel_stats
+    },
+    [ACCEL_GRID] = {
+        "grid", create_grid_accel, rebuild_grid_accel, copy_grid_accel, complete_grid_accel, destroy_grid_accel,
+        intersect_grid_accel, occluded_grid_accel, get_grid_accel_bounds, get_grid_accel_stats
+    },
+    [ACCEL_PAGED] = {
+        "paged", create_paged_accel_data, rebuild_paged_accel, copy_paged_accel, complete_paged_accel, destroy_paged_accel,
+        intersect_paged_accel, occluded_paged_accel, get_paged_accel_bounds, get_paged_accel_stats
+    }
+};
+
+Accel create_accel(AccelType type, Triangle* triangles, size_t count, BVHBuilder builder) {
+    Accel accel;
+    memset(&accel, 0, sizeof(accel));
+    accel.backend = &accel_backends[type];
+    accel.type = type;
+    accel.backend->create(&accel, triangles, count, builder);
+    return accel;
+}
+
+// Takes over the caller's reference to the geometry
+Accel create_paged_accel(PagedGeometry* geometry) {
+    Accel accel;
+    memset(&accel, 0, sizeof(accel));
+    accel.backend = &accel_backends[ACCEL_PAGED];
+    accel.type = ACCEL_PAGED;
+    accel.paged = geometry;
+    return accel;
+}
+
+// Call after the triangles were modified, storage of the previous build is reused
+void rebuild_accel(Accel* accel, BVHBuilder builder) {
+    if (accel->backend) accel->backend->rebuild(accel, builder);
+}
+
+Accel copy_accel(const Accel* accel, Triangle* triangles) {
+    Accel copy = *accel;
+    if (accel->backend) accel->backend->copy(accel, &copy, triangles);
+    return copy;
+}
+
+// Finish deferred work, e.g. before triangle indices are handed out without traversal
+void complete_accel(Accel* accel) {
+    if (accel->backend) accel->backend->complete(accel);
+}
+
+void destroy_accel(Accel* accel) {
+    if (accel->backend) accel->backend->destroy(accel);
+    accel->backend = NULL;
+}
+
+bool intersect_accel(const Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    return accel->backend && accel->backend->intersect(accel, ray, t_out, u_out, v_out, tri_idx);
+}
+
+bool occluded_accel(const Accel* accel, Ray ray, float max_distance) {
+    return accel->backend && accel->backend->occluded(accel, ray, max_distance);
+}
+
+AABB get_accel_bounds(const Accel* accel) {
+    return accel->backend ? accel->backend->get_bounds(accel) : create_empty_aabb();
+}
+
+AccelStats get_accel_stats(const Accel* accel) {
+    if (!accel->backend) return (AccelStats){0, 0, 0};
+    return accel->backend->get_stats(accel);
+}
+
+const char* get_accel_type_name(AccelType type) {
+    return accel_backends[type].name;
+}
+
+bool parse_accel_type(const char* name, AccelType* type) {
+    for (int i = 0; i < ACCEL_TYPE_COUNT; i++) {
+        if (strcmp(name, accel_backends[i].name) == 0) {
+            *type = (AccelType)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef ACCEL_H
+#define ACCEL_H
+
+#include "bvh.h"
+#include "grid.h"
+#include "paged.h"
+
+typedef enum {
+    ACCEL_BVH,                  // Bounding volume hierarchy, built with the mesh's BVHBuilder
+    ACCEL_GRID,                 // Uniform grid with 3D-DDA traversal, for dense evenly sized triangles
+    ACCEL_PAGED,                // BVH whose lower levels and triangles are paged in from a file
+    ACCEL_TYPE_COUNT
+} AccelType;
+
+typedef struct {
+    size_t node_count;          // BVH nodes or grid cells
+    size_t reference_count;     // Triangle references held by leaves or cells
+    size_t memory_bytes;        // Nodes, cells and reference lists, triangles excluded
+} AccelStats;
+
+struct Accel;
+
+// Function table of one acceleration structure backend
+typedef struct {
+    const char* name;
+    void (*create)(struct Accel* accel, Triangle* triangles, size_t count, BVHBuilder builder);
+    void (*rebuild)(struct Accel* accel, BVHBuilder builder);
+    void (*copy)(const struct Accel* accel, struct Accel* copy, Triangle* triangles);
+    void (*complete)(struct Accel* accel);
+    void (*destroy)(struct Accel* accel);
+    bool (*intersect)(const struct Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx);
+    bool (*occluded)(const struct Accel* accel, Ray ray, float max_distance);
+    AABB (*get_bounds)(const struct Accel* accel);
+    AccelStats (*get_stats)(const struct Accel* accel);
+} AccelBackend;
+
+// Per-mesh acceleration structure, the backend decides which member of the union is live
+typedef struct Accel {
+    const AccelBackend* backend;
+    AccelType type;
+    union {
+        BVH bvh;
+        Grid grid;
+        PagedGeometry* paged;   // Shared by copies, released with the last one
+    };
+} Accel;
+
+// Acceleration structure operations, triangle indices refer to the triangles passed at creation.
+// A BVH or paged BVH reorders those triangles, a grid leaves them in place.
+Accel create_accel(AccelType type, Triangle* triangles, size_t count, BVHBuilder builder);
+Accel create_paged_accel(PagedGeometry* geometry);
+void rebuild_accel(Accel* accel, BVHBuilder builder);
+Accel copy_accel(const Accel* accel, Triangle* triangles);
+void complete_accel(Accel* accel);
+void destroy_accel(Accel* accel);
+bool intersect_accel(const Accel* accel, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx);
+bool occluded_accel(const Accel* accel, Ray ray, float max_distance);
+AABB get_accel_bounds(const Accel* accel);
+AccelStats get_accel_stats(const Accel* accel);
+const char* get_accel_type_name(AccelType type);
+bool parse_accel_type(const char* name, AccelType* type);
+
+#endif
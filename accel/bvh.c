@@ -1,85 +1,302 @@
 #include "bvh.h"
+#include "lbvh.h"
 #include "math/ray.h"
+#include "utils/stats.h"
+#include <string.h>
+#include <sched.h>
 
-BVHNode* create_bvh_node(Triangle* triangles, int start, int count) {
-    BVHNode* node = (BVHNode*)malloc(sizeof(BVHNode));
+#define BVH_TASK_THRESHOLD 4096        // Smaller subtrees are built by a single task
+#define BVH_PARALLEL_THRESHOLD 65536   // Larger nodes bin and partition in parallel
+#define BVH_CHUNK_SIZE 8192            // Fixed chunking keeps parallel sums deterministic
+#define BVH_LAZY_DEPTH 8               // Levels the lazy builder splits up front, at most 256 pending subtrees
+
+typedef struct {
+    BVH* bvh;
+    Triangle* scratch;          // Partition buffer for the parallel top levels
+    int lazy_depth;             // Nodes this deep stay pending, 0 builds everything
+    bool serial;                // Lazy subtrees are split by the traversing thread alone
+} BVHBuild;
+
+BVHNode* alloc_bvh_node(BVH* bvh) {
+    size_t index;
+    #pragma omp atomic capture
+    index = bvh->node_count++;
+    bvh->nodes[index].state = BVH_NODE_READY;
+    return &bvh->nodes[index];
+}
+
+static float get_centroid_axis(const Triangle* tri, int axis) {
+    Vec3 centroid = vec3_mul(vec3_add(vec3_add(tri->v0, tri->v1), tri->v2), 1.0f/3.0f);
+    return axis == 0 ? centroid.x : (axis == 1 ? centroid.y : centroid.z);
+}
+
+static AABB get_triangle_range_bounds(const Triangle* triangles, int start, int count) {
+    AABB bounds = create_empty_aabb();
+    for (int i = 0; i < count; i++) {
+        bounds = expand_aabb(bounds, triangles[start + i].v0);
+        bounds = expand_aabb(bounds, triangles[start + i].v1);
+        bounds = expand_aabb(bounds, triangles[start + i].v2);
+    }
+    return bounds;
+}
+
+static int get_longest_axis(AABB bounds) {
+    Vec3 extent = vec3_sub(bounds.max, bounds.min);
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent.x && extent.z > extent.y) axis = 2;
+    return axis;
+}
+
+// Mean-centroid split of one node, returns the first index of the right child
+static int partition_serial(Triangle* triangles, int start, int count, int axis) {
+    float split = 0.0f;
+    for (int i = 0; i < count; i++) {
+        split += get_centroid_axis(&triangles[start + i], axis);
+    }
+    split /= count;
+
+    int mid = start;
+    for (int i = 0; i < count; i++) {
+        if (get_centroid_axis(&triangles[start + i], axis) < split) {
+            Triangle temp = triangles[start + i];
+            triangles[start + i] = triangles[mid];
+            triangles[mid] = temp;
+            mid++;
+        }
+    }
+    return mid;
+}
+
+// Same split as partition_serial, with chunked sums and a stable scatter through scratch
+static int partition_parallel(Triangle* triangles, Triangle* scratch, int start, int count, int axis) {
+    int chunk_count = (count + BVH_CHUNK_SIZE - 1) / BVH_CHUNK_SIZE;
+    float* chunk_sums = (float*)malloc(chunk_count * sizeof(float));
+    int* chunk_left = (int*)malloc(chunk_count * sizeof(int));
+
+    #pragma omp taskloop grainsize(1)
+    for (int c = 0; c < chunk_count; c++) {
+        int begin = start + c * BVH_CHUNK_SIZE;
+        int end = begin + BVH_CHUNK_SIZE < start + count ? begin + BVH_CHUNK_SIZE : start + count;
+        float sum = 0.0f;
+        for (int i = begin; i < end; i++) sum += get_centroid_axis(&triangles[i], axis);
+        chunk_sums[c] = sum;
+    }
+
+    float split = 0.0f;
+    for (int c = 0; c < chunk_count; c++) split += chunk_sums[c];
+    split /= count;
+
+    #pragma omp taskloop grainsize(1)
+    for (int c = 0; c < chunk_count; c++) {
+        int begin = start + c * BVH_CHUNK_SIZE;
+        int end = begin + BVH_CHUNK_SIZE < start + count ? begin + BVH_CHUNK_SIZE : start + count;
+        int left = 0;
+        for (int i = begin; i < end; i++) left += get_centroid_axis(&triangles[i], axis) < split;
+        chunk_left[c] = left;
+    }
+
+    // Exclusive prefix sums give each chunk its output ranges on both sides
+    int left_total = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        int left = chunk_left[c];
+        chunk_left[c] = left_total;
+        left_total += left;
+    }
+
+    #pragma omp taskloop grainsize(1)
+    for (int c = 0; c < chunk_count; c++) {
+        int begin = start + c * BVH_CHUNK_SIZE;
+        int end = begin + BVH_CHUNK_SIZE < start + count ? begin + BVH_CHUNK_SIZE : start + count;
+        int left = start + chunk_left[c];
+        int right = start + left_total + (begin - start - chunk_left[c]);
+        for (int i = begin; i < end; i++) {
+            if (get_centroid_axis(&triangles[i], axis) < split) scratch[left++] = triangles[i];
+            else scratch[right++] = triangles[i];
+        }
+    }
+
+    #pragma omp taskloop grainsize(1)
+    for (int c = 0; c < chunk_count; c++) {
+        int begin = start + c * BVH_CHUNK_SIZE;
+        int end = begin + BVH_CHUNK_SIZE < start + count ? begin + BVH_CHUNK_SIZE : start + count;
+        memcpy(&triangles[begin], &scratch[begin], (end - begin) * sizeof(Triangle));
+    }
+
+    free(chunk_sums);
+    free(chunk_left);
+    return start + left_total;
+}
+
+static AABB get_triangle_range_bounds_parallel(const Triangle* triangles, int start, int count) {
+    int chunk_count = (count + BVH_CHUNK_SIZE - 1) / BVH_CHUNK_SIZE;
+    AABB* chunk_bounds = (AABB*)malloc(chunk_count * sizeof(AABB));
+
+    #pragma omp taskloop grainsize(1)
+    for (int c = 0; c < chunk_count; c++) {
+        int begin = c * BVH_CHUNK_SIZE;
+        int size = begin + BVH_CHUNK_SIZE < count ? BVH_CHUNK_SIZE : count - begin;
+        chunk_bounds[c] = get_triangle_range_bounds(triangles, start + begin, size);
+    }
+
+    AABB bounds = create_empty_aabb();
+    for (int c = 0; c < chunk_count; c++) bounds = merge_aabb(bounds, chunk_bounds[c]);
+    free(chunk_bounds);
+    return bounds;
+}
+
+static void split_bvh_node(BVHBuild* build, BVHNode* node, int depth);
+
+static BVHNode* create_bvh_node(BVHBuild* build, int start, int count, int depth) {
+    Triangle* triangles = build->bvh->triangles;
+    bool parallel = !build->serial && count >= BVH_PARALLEL_THRESHOLD;
+
+    BVHNode* node = alloc_bvh_node(build->bvh);
     node->start_idx = start;
     node->triangle_count = count;
     node->left = node->right = NULL;
 
     // Calculate bounds
-    node->bounds = create_empty_aabb();
-    for (int i = 0; i < count; i++) {
-        node->bounds = expand_aabb(node->bounds, triangles[start + i].v0);
-        node->bounds = expand_aabb(node->bounds, triangles[start + i].v1);
-        node->bounds = expand_aabb(node->bounds, triangles[start + i].v2);
+    node->bounds = parallel ? get_triangle_range_bounds_parallel(triangles, start, count)
+                            : get_triangle_range_bounds(triangles, start, count);
+
+    // Deep subtrees of a lazy build wait until a ray reaches them
+    if (build->lazy_depth > 0 && depth >= build->lazy_depth && count > 4) {
+        node->state = BVH_NODE_PENDING;
+        return node;
     }
 
+    split_bvh_node(build, node, depth);
+    return node;
+}
+
+static void split_bvh_node(BVHBuild* build, BVHNode* node, int depth) {
+    Triangle* triangles = build->bvh->triangles;
+    int start = node->start_idx;
+    int count = node->triangle_count;
+    bool parallel = !build->serial && count >= BVH_PARALLEL_THRESHOLD;
+
     // Split if more than 4 triangles
     if (count > 4) {
-        // Find longest axis
-        Vec3 extent = vec3_sub(node->bounds.max, node->bounds.min);
-        int axis = 0;
-        if (extent.y > extent.x) axis = 1;
-        if (extent.z > extent.x && extent.z > extent.y) axis = 2;
-
-        // Sort triangles based on centroid
-        float split = 0.0f;
-        for (int i = 0; i < count; i++) {
-            Triangle* tri = &triangles[start + i];
-            Vec3 centroid = vec3_mul(vec3_add(vec3_add(tri->v0, tri->v1), tri->v2), 1.0f/3.0f);
-            split += axis == 0 ? centroid.x : (axis == 1 ? centroid.y : centroid.z);
-        }
-        split /= count;
-
-        // Partition triangles
-        int mid = start;
-        for (int i = 0; i < count; i++) {
-            Triangle* tri = &triangles[start + i];
-            Vec3 centroid = vec3_mul(vec3_add(vec3_add(tri->v0, tri->v1), tri->v2), 1.0f/3.0f);
-            float value = axis == 0 ? centroid.x : (axis == 1 ? centroid.y : centroid.z);
-            
-            if (value < split) {
-                Triangle temp = triangles[start + i];
-                triangles[start + i] = triangles[mid];
-                triangles[mid] = temp;
-                mid++;
-            }
-        }
+        int axis = get_longest_axis(node->bounds);
+        int mid = parallel ? partition_parallel(triangles, build->scratch, start, count, axis)
+                           : partition_serial(triangles, start, count, axis);
 
-        // Create children
+        // Create children, large subtrees become independent tasks
         int left_count = mid - start;
         if (left_count > 0 && left_count < count) {
-            node->left = create_bvh_node(triangles, start, left_count);
-            node->right = create_bvh_node(triangles, mid, count - left_count);
+            if (!build->serial && count >= BVH_TASK_THRESHOLD) {
+                #pragma omp task
+                node->left = create_bvh_node(build, start, left_count, depth + 1);
+                node->right = create_bvh_node(build, mid, count - left_count, depth + 1);
+                #pragma omp taskwait
+            } else {
+                node->left = create_bvh_node(build, start, left_count, depth + 1);
+                node->right = create_bvh_node(build, mid, count - left_count, depth + 1);
+            }
         }
     }
+}
 
-    return node;
+static void build_mean_split_bvh(BVH* bvh, int lazy_depth) {
+    size_t count = bvh->triangle_count;
+    BVHBuild build = {bvh, NULL, lazy_depth, false};
+    if (count >= BVH_PARALLEL_THRESHOLD) build.scratch = (Triangle*)malloc(count * sizeof(Triangle));
+
+    #pragma omp parallel if(count >= BVH_TASK_THRESHOLD)
+    #pragma omp single
+    bvh->root = create_bvh_node(&build, 0, count, 0);
+
+    free(build.scratch);
 }
 
 BVH create_bvh(Triangle* triangles, size_t count) {
+    return create_bvh_with_builder(triangles, count, BVH_BUILDER_MEAN_SPLIT);
+}
+
+BVH create_bvh_with_builder(Triangle* triangles, size_t count, BVHBuilder builder) {
     BVH bvh;
     bvh.triangles = triangles;
     bvh.triangle_count = count;
-    bvh.root = create_bvh_node(triangles, 0, count);
+    bvh.root = NULL;
+    bvh.arena = create_arena((count > 0 ? 2 * count - 1 : 1) * sizeof(BVHNode));
+    rebuild_bvh(&bvh, builder);
     return bvh;
 }
 
-void destroy_bvh_node(BVHNode* node) {
-    if (node->left) destroy_bvh_node(node->left);
-    if (node->right) destroy_bvh_node(node->right);
-    free(node);
+void rebuild_bvh(BVH* bvh, BVHBuilder builder) {
+    // Every split leaves both children non-empty, so 2n-1 nodes always suffice
+    size_t node_capacity = bvh->triangle_count > 0 ? 2 * bvh->triangle_count - 1 : 1;
+
+    // The previous pool is reused when rebuilding, so per-frame rebuilds do not allocate
+    reset_arena(&bvh->arena);
+    bvh->nodes = (BVHNode*)arena_alloc(&bvh->arena, node_capacity * sizeof(BVHNode), ARENA_ALIGNMENT);
+    bvh->node_count = 0;
+
+    if (builder == BVH_BUILDER_MORTON) build_lbvh(bvh);
+    else build_mean_split_bvh(bvh, builder == BVH_BUILDER_LAZY ? BVH_LAZY_DEPTH : 0);
+}
+
+// Child pointers are rebased into the new pool, the copy traverses triangles in the same order
+BVH copy_bvh(const BVH* bvh, Triangle* triangles) {
+    BVH copy;
+    copy.triangles = triangles;
+    copy.triangle_count = bvh->triangle_count;
+    copy.node_count = bvh->node_count;
+
+    // Full capacity, pending lazy subtrees of the copy are split into its own pool
+    size_t node_capacity = bvh->triangle_count > 0 ? 2 * bvh->triangle_count - 1 : 1;
+    copy.arena = create_arena(node_capacity * sizeof(BVHNode));
+    copy.nodes = (BVHNode*)arena_alloc(&copy.arena, node_capacity * sizeof(BVHNode), ARENA_ALIGNMENT);
+    memcpy(copy.nodes, bvh->nodes, bvh->node_count * sizeof(BVHNode));
+    for (size_t i = 0; i < copy.node_count; i++) {
+        if (copy.nodes[i].left) copy.nodes[i].left = copy.nodes + (bvh->nodes[i].left - bvh->nodes);
+        if (copy.nodes[i].right) copy.nodes[i].right = copy.nodes + (bvh->nodes[i].right - bvh->nodes);
+    }
+    copy.root = bvh->root ? copy.nodes + (bvh->root - bvh->nodes) : NULL;
+    return copy;
 }
 
 void destroy_bvh(BVH* bvh) {
-    if (bvh->root) destroy_bvh_node(bvh->root);
+    destroy_arena(&bvh->arena);
     bvh->root = NULL;
+    bvh->nodes = NULL;
+    bvh->node_count = 0;
 }
 
-bool intersect_bvh(BVHNode* node, Ray ray, const Triangle* triangles,
-                   float* t_out, float* u_out, float* v_out, int* tri_idx) {
-    if (!ray_aabb_intersect(ray, node->bounds)) return false;
+// Split a pending subtree once, threads arriving meanwhile wait for the builder
+static void build_pending_node(BVH* bvh, BVHNode* node) {
+    int expected = BVH_NODE_PENDING;
+    if (__atomic_compare_exchange_n(&node->state, &expected, BVH_NODE_BUILDING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        BVHBuild build = {bvh, NULL, 0, true};
+        split_bvh_node(&build, node, 0);
+        __atomic_store_n(&node->state, BVH_NODE_READY, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != BVH_NODE_READY) sched_yield();
+}
+
+static void complete_bvh_node(BVH* bvh, BVHNode* node) {
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != BVH_NODE_READY) build_pending_node(bvh, node);
+    if (node->left) complete_bvh_node(bvh, node->left);
+    if (node->right) complete_bvh_node(bvh, node->right);
+}
+
+// Split every pending subtree, e.g. before triangle indices are handed out without traversal
+void complete_bvh(BVH* bvh) {
+    if (bvh->root) complete_bvh_node(bvh, bvh->root);
+}
+
+static bool intersect_bvh_node(BVH* bvh, BVHNode* node, Ray ray, const SlabRay* slab,
+                               float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    STATS_INC(node_visits);
+
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != BVH_NODE_READY) build_pending_node(bvh, node);
+
+    const Triangle* triangles = bvh->triangles;
 
     bool hit = false;
     float closest_t = *t_out;
@@ -107,8 +324,8 @@ bool intersect_bvh(BVHNode* node, Ray ray, const Triangle* triangles,
         float u1, v1, u2, v2;
         int idx1, idx2;
 
-        bool hit1 = node->left ? intersect_bvh(node->left, ray, triangles, &t1, &u1, &v1, &idx1) : false;
-        bool hit2 = node->right ? intersect_bvh(node->right, ray, triangles, &t2, &u2, &v2, &idx2) : false;
+        bool hit1 = node->left ? intersect_bvh_node(bvh, node->left, ray, slab, &t1, &u1, &v1, &idx1) : false;
+        bool hit2 = node->right ? intersect_bvh_node(bvh, node->right, ray, slab, &t2, &u2, &v2, &idx2) : false;
 
         if (hit1 && (!hit2 || t1 < t2)) {
             *t_out = t1;
@@ -126,4 +343,37 @@ bool intersect_bvh(BVHNode* node, Ray ray, const Triangle* triangles,
     }
 
     return hit;
-}
\ No newline at end of file
+}
+
+// Lazy subtrees are the only part of the BVH a traversal writes, guarded by their node state
+bool intersect_bvh(const BVH* bvh, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    if (!bvh->root) return false;
+    SlabRay slab = create_slab_ray(ray);
+    return intersect_bvh_node((BVH*)bvh, bvh->root, ray, &slab, t_out, u_out, v_out, tri_idx);
+}
+
+static bool occluded_bvh_node(BVH* bvh, BVHNode* node, Ray ray, const SlabRay* slab, float max_distance) {
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    STATS_INC(node_visits);
+
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != BVH_NODE_READY) build_pending_node(bvh, node);
+
+    if (node->left == NULL && node->right == NULL) {
+        for (int i = 0; i < node->triangle_count; i++) {
+            const Triangle* tri = &bvh->triangles[node->start_idx + i];
+            float t, u, v;
+            if (ray_triangle_intersect(ray, tri->v0, tri->v1, tri->v2, &t, &u, &v) && t < max_distance) return true;
+        }
+        return false;
+    }
+    return (node->left && occluded_bvh_node(bvh, node->left, ray, slab, max_distance)) ||
+           (node->right && occluded_bvh_node(bvh, node->right, ray, slab, max_distance));
+}
+
+// Shadow rays stop at the first hit closer than max_distance instead of searching for the closest
+bool occluded_bvh(const BVH* bvh, Ray ray, float max_distance) {
+    if (!bvh->root) return false;
+    SlabRay slab = create_slab_ray(ray);
+    return occluded_bvh_node((BVH*)bvh, bvh->root, ray, &slab, max_distance);
+}
@@ -3,28 +3,48 @@
 
 #include "geometry/aabb.h"
 #include "geometry/triangle.h"
+#include "utils/arena.h"
 #include <stdlib.h>
 
+typedef enum {
+    BVH_BUILDER_MEAN_SPLIT,     // Longest-axis mean-centroid split, best tree quality
+    BVH_BUILDER_MORTON,         // Linear BVH over Morton-sorted centroids, fastest build
+    BVH_BUILDER_LAZY            // Mean split of the top levels, deeper subtrees on first traversal
+} BVHBuilder;
+
+typedef enum {
+    BVH_NODE_READY,             // Children, if any, are built
+    BVH_NODE_PENDING,           // Lazy subtree, split by the first ray that reaches it
+    BVH_NODE_BUILDING           // Being split by another thread
+} BVHNodeState;
+
 typedef struct BVHNode {
     AABB bounds;
     struct BVHNode* left;
     struct BVHNode* right;
     int start_idx;
     int triangle_count;
+    int state;                  // BVHNodeState, accessed atomically
 } BVHNode;
 
 typedef struct {
     BVHNode* root;
     Triangle* triangles;
     size_t triangle_count;
+    BVHNode* nodes;             // Pool of 2n-1 nodes, handed out atomically during the build
+    size_t node_count;
+    Arena arena;                // Owns the node pool, released in one go
 } BVH;
 
-// BVH operations
-BVHNode* create_bvh_node(Triangle* triangles, int start, int count);
+// BVH operations, large meshes are built in parallel with OpenMP tasks
 BVH create_bvh(Triangle* triangles, size_t count);
-void destroy_bvh_node(BVHNode* node);
+BVH create_bvh_with_builder(Triangle* triangles, size_t count, BVHBuilder builder);
+void rebuild_bvh(BVH* bvh, BVHBuilder builder);
+BVH copy_bvh(const BVH* bvh, Triangle* triangles);
+void complete_bvh(BVH* bvh);
+BVHNode* alloc_bvh_node(BVH* bvh);
 void destroy_bvh(BVH* bvh);
-bool intersect_bvh(BVHNode* node, Ray ray, const Triangle* triangles,
-                   float* t_out, float* u_out, float* v_out, int* tri_idx);
+bool intersect_bvh(const BVH* bvh, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx);
+bool occluded_bvh(const BVH* bvh, Ray ray, float max_distance);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "grid.h"
+#include "math/ray.h"
+#include "utils/stats.h"
+#include <string.h>
+
+typedef struct {
+    int cell[3];
+    int step[3];
+    float t_next[3];            // Ray distance to the next cell boundary on each axis
+    float t_delta[3];           // Ray distance between boundaries on each axis
+    float t_far;                // Ray distance where it leaves the grid
+} GridWalk;
+
+static float get_axis(Vec3 v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static int clamp_cell(float f, int resolution) {
+    int cell = (int)floorf(f);
+    return cell < 0 ? 0 : (cell >= resolution ? resolution - 1 : cell);
+}
+
+static size_t get_cell_index(const Grid* grid, const int cell[3]) {
+    return ((size_t)cell[2] * grid->resolution[1] + cell[1]) * grid->resolution[0] + cell[0];
+}
+
+// About GRID_CELLS_PER_TRIANGLE cells of equal size, axes a mesh is flat along get a single cell
+static void choose_grid_resolution(Grid* grid) {
+    Vec3 extent = vec3_sub(grid->bounds.max, grid->bounds.min);
+    float largest = fmaxf(extent.x, fmaxf(extent.y, extent.z));
+    double volume = 1.0;
+    int axes = 0;
+    for (int a = 0; a < 3; a++) {
+        if (get_axis(extent, a) > largest * 1e-3f) {
+            volume *= get_axis(extent, a);
+            axes++;
+        }
+    }
+    double density = axes > 0 ? pow((double)grid->triangle_count * GRID_CELLS_PER_TRIANGLE / volume, 1.0 / axes) : 0.0;
+
+    float cell_size[3];
+    for (int a = 0; a < 3; a++) {
+        int resolution = 1;
+        if (get_axis(extent, a) > largest * 1e-3f) resolution = (int)ceil(get_axis(extent, a) * density);
+        if (resolution < 1) resolution = 1;
+        if (resolution > GRID_MAX_RESOLUTION) resolution = GRID_MAX_RESOLUTION;
+        grid->resolution[a] = resolution;
+        cell_size[a] = get_axis(extent, a) / resolution;
+    }
+    grid->cell_size = (Vec3){cell_size[0], cell_size[1], cell_size[2]};
+    grid->inv_cell_size = (Vec3){1.0f / cell_size[0], 1.0f / cell_size[1], 1.0f / cell_size[2]};
+    grid->cell_count = (size_t)grid->resolution[0] * grid->resolution[1] * grid->resolution[2];
+}
+
+// Cells overlapped by the bounds of a triangle
+static void get_cell_range(const Grid* grid, const Triangle* tri, int lo[3], int hi[3]) {
+    AABB box = get_triangle_bounds(*tri);
+    for (int a = 0; a < 3; a++) {
+        float origin = get_axis(grid->bounds.min, a);
+        float inv_size = get_axis(grid->inv_cell_size, a);
+        lo[a] = clamp_cell((get_axis(box.min, a) - origin) * inv_size, grid->resolution[a]);
+        hi[a] = clamp_cell((get_axis(box.max, a) - origin) * inv_size, grid->resolution[a]);
+    }
+}
+
+// Counting sort of triangle references by cell, so each cell lists its triangles contiguously
+void rebuild_grid(Grid* grid) {
+    grid->bounds = create_empty_aabb();
+    for (size_t i = 0; i < grid->triangle_count; i++) {
+        grid->bounds = merge_aabb(grid->bounds, get_triangle_bounds(grid->triangles[i]));
+    }
+    if (grid->triangle_count == 0) grid->bounds = (AABB){{0, 0, 0}, {0, 0, 0}};
+    Vec3 extent = vec3_sub(grid->bounds.max, grid->bounds.min);
+    float pad = fmaxf(extent.x, fmaxf(extent.y, extent.z)) * 1e-4f + 1e-6f;
+    grid->bounds.min = vec3_sub(grid->bounds.min, (Vec3){pad, pad, pad});
+    grid->bounds.max = vec3_add(grid->bounds.max, (Vec3){pad, pad, pad});
+    choose_grid_resolution(grid);
+
+    reset_arena(&grid->arena);
+    grid->cell_offsets = (int*)arena_alloc(&grid->arena, (grid->cell_count + 1) * sizeof(int), ARENA_ALIGNMENT);
+    memset(grid->cell_offsets, 0, (grid->cell_count + 1) * sizeof(int));
+
+    int lo[3], hi[3], cell[3];
+    for (size_t i = 0; i < grid->triangle_count; i++) {
+        get_cell_range(grid, &grid->triangles[i], lo, hi);
+        for (cell[2] = lo[2]; cell[2] <= hi[2]; cell[2]++)
+            for (cell[1] = lo[1]; cell[1] <= hi[1]; cell[1]++)
+                for (cell[0] = lo[0]; cell[0] <= hi[0]; cell[0]++)
+                    grid->cell_offsets[get_cell_index(grid, cell) + 1]++;
+    }
+    for (size_t c = 0; c < grid->cell_count; c++) grid->cell_offsets[c + 1] += grid->cell_offsets[c];
+    grid->reference_count = grid->cell_offsets[grid->cell_count];
+
+    grid->references = (int*)arena_alloc(&grid->arena, (grid->reference_count > 0 ? grid->reference_count : 1) * sizeof(int),
+                                         ARENA_ALIGNMENT);
+    int* cursors = (int*)malloc(grid->cell_count * sizeof(int));
+    memcpy(cursors, grid->cell_offsets, grid->cell_count * sizeof(int));
+    for (size_t i = 0; i < grid->triangle_count; i++) {
+        get_cell_range(grid, &grid->triangles[i], lo, hi);
+        for (cell[2] = lo[2]; cell[2] <= hi[2]; cell[2]++)
+            for (cell[1] = lo[1]; cell[1] <= hi[1]; cell[1]++)
+                for (cell[0] = lo[0]; cell[0] <= hi[0]; cell[0]++)
+                    grid->references[cursors[get_cell_index(grid, cell)]++] = (int)i;
+    }
+    free(cursors);
+}
+
+Grid create_grid(Triangle* triangles, size_t count) {
+    Grid grid;
+    grid.triangles = triangles;
+    grid.triangle_count = count;
+    grid.arena = create_arena(ARENA_BLOCK_SIZE);
+    rebuild_grid(&grid);
+    return grid;
+}
+
+// Offsets and references are rebased into a fresh arena, the copy walks the same cells
+Grid copy_grid(const Grid* grid, Triangle* triangles) {
+    Grid copy = *grid;
+    copy.triangles = triangles;
+    copy.arena = create_arena(ARENA_BLOCK_SIZE);
+    copy.cell_offsets = (int*)arena_alloc(&copy.arena, (grid->cell_count + 1) * sizeof(int), ARENA_ALIGNMENT);
+    memcpy(copy.cell_offsets, grid->cell_offsets, (grid->cell_count + 1) * sizeof(int));
+    copy.references = (int*)arena_alloc(&copy.arena, (grid->reference_count > 0 ? grid->reference_count : 1) * sizeof(int),
+                                        ARENA_ALIGNMENT);
+    memcpy(copy.references, grid->references, grid->reference_count * sizeof(int));
+    return copy;
+}
+
+void destroy_grid(Grid* grid) {
+    destroy_arena(&grid->arena);
+    grid->cell_offsets = NULL;
+    grid->references = NULL;
+    grid->cell_count = 0;
+    grid->reference_count = 0;
+}
+
+// Clip the ray to the grid and set up the DDA in the cell it enters first
+static bool begin_grid_walk(const Grid* grid, Ray ray, GridWalk* walk, float* t_enter) {
+    STATS_INC(box_tests);
+    float t_near = 0.0f, t_far = 1e30f;
+    for (int a = 0; a < 3; a++) {
+        float inv_dir = 1.0f / get_axis(ray.direction, a);
+        float t1 = (get_axis(grid->bounds.min, a) - get_axis(ray.origin, a)) * inv_dir;
+        float t2 = (get_axis(grid->bounds.max, a) - get_axis(ray.origin, a)) * inv_dir;
+        t_near = fmaxf(t_near, fminf(t1, t2));
+        t_far = fminf(t_far, fmaxf(t1, t2));
+    }
+    if (t_near > t_far) return false;
+
+    Vec3 entry = vec3_add(ray.origin, vec3_mul(ray.direction, t_near));
+    for (int a = 0; a < 3; a++) {
+        float origin = get_axis(grid->bounds.min, a);
+        float size = get_axis(grid->cell_size, a);
+        float direction = get_axis(ray.direction, a);
+        walk->cell[a] = clamp_cell((get_axis(entry, a) - origin) * get_axis(grid->inv_cell_size, a), grid->resolution[a]);
+        if (direction > 0.0f) {
+            walk->step[a] = 1;
+            walk->t_next[a] = (origin + (walk->cell[a] + 1) * size - get_axis(ray.origin, a)) / direction;
+            walk->t_delta[a] = size / direction;
+        } else if (direction < 0.0f) {
+            walk->step[a] = -1;
+            walk->t_next[a] = (origin + walk->cell[a] * size - get_axis(ray.origin, a)) / direction;
+            walk->t_delta[a] = -size / direction;
+        } else {
+            walk->step[a] = 0;
+            walk->t_next[a] = 1e30f;
+            walk->t_delta[a] = 1e30f;
+        }
+    }
+    walk->t_far = t_far;
+    *t_enter = t_near;
+    return true;
+}
+
+// Step into the neighbouring cell whose boundary comes first, false once the ray leaves the grid
+static bool advance_grid_walk(const Grid* grid, GridWalk* walk, float* t_enter) {
+    int axis = walk->t_next[0] < walk->t_next[1] ?
+               (walk->t_next[0] < walk->t_next[2] ? 0 : 2) :
+               (walk->t_next[1] < walk->t_next[2] ? 1 : 2);
+    *t_enter = walk->t_next[axis];
+    if (*t_enter > walk->t_far) return false;
+    walk->cell[axis] += walk->step[axis];
+    if (walk->cell[axis] < 0 || walk->cell[axis] >= grid->resolution[axis]) return false;
+    walk->t_next[axis] += walk->t_delta[axis];
+    return true;
+}
+
+// Triangles spanning several cells are tested once per cell, a hit only ends the walk
+// once it lies before the current cell's exit, so nearer triangles in later cells are not missed
+bool intersect_grid(const Grid* grid, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    GridWalk walk;
+    float t_enter;
+    if (grid->triangle_count == 0 || !begin_grid_walk(grid, ray, &walk, &t_enter)) return false;
+
+    bool hit = false;
+    float closest_t = *t_out;
+    do {
+        if (t_enter > closest_t) break;
+        STATS_INC(node_visits);
+        size_t c = get_cell_index(grid, walk.cell);
+        for (int r = grid->cell_offsets[c]; r < grid->cell_offsets[c + 1]; r++) {
+            const Triangle* tri = &grid->triangles[grid->references[r]];
+            float t, u, v;
+            if (ray_triangle_intersect(ray, tri->v0, tri->v1, tri->v2, &t, &u, &v) && t < closest_t) {
+                closest_t = t;
+                *t_out = t;
+                *u_out = u;
+                *v_out = v;
+                *tri_idx = grid->references[r];
+                hit = true;
+            }
+        }
+        float cell_exit = fminf(walk.t_next[0], fminf(walk.t_next[1], walk.t_next[2]));
+        if (hit && closest_t <= cell_exit) break;
+    } while (advance_grid_walk(grid, &walk, &t_enter));
+    return hit;
+}
+
+// Any hit before max_distance ends the walk
+bool occluded_grid(const Grid* grid, Ray ray, float max_distance) {
+    GridWalk walk;
+    float t_enter;
+    if (grid->triangle_count == 0 || !begin_grid_walk(grid, ray, &walk, &t_enter)) return false;
+
+    do {
+        if (t_enter >= max_distance) break;
+        STATS_INC(node_visits);
+        size_t c = get_cell_index(grid, walk.cell);
+        for (int r = grid->cell_offsets[c]; r < grid->cell_offsets[c + 1]; r++) {
+            const Triangle* tri = &grid->triangles[grid->references[r]];
+            float t, u, v;
+            if (ray_triangle_intersect(ray, tri->v0, tri->v1, tri->v2, &t, &u, &v) && t < max_distance) return true;
+        }
+    } while (advance_grid_walk(grid, &walk, &t_enter));
+    return false;
+}
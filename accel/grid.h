@@ -0,0 +1,34 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "geometry/aabb.h"
+#include "geometry/triangle.h"
+#include "utils/arena.h"
+#include <stdlib.h>
+
+#define GRID_CELLS_PER_TRIANGLE 2       // Target cell count relative to the triangle count
+#define GRID_MAX_RESOLUTION 256         // Cells per axis
+
+typedef struct {
+    Triangle* triangles;
+    size_t triangle_count;
+    AABB bounds;                // Triangle bounds, padded so flat meshes get a non-zero thickness
+    int resolution[3];          // Cells along x, y and z
+    Vec3 cell_size;
+    Vec3 inv_cell_size;
+    int* cell_offsets;          // cell_count + 1 prefix sums into references
+    int* references;            // Triangle indices grouped by cell, ascending within a cell
+    size_t cell_count;
+    size_t reference_count;
+    Arena arena;                // Owns offsets and references
+} Grid;
+
+// Uniform grid operations, traversal walks the cells along the ray with a 3D-DDA
+Grid create_grid(Triangle* triangles, size_t count);
+void rebuild_grid(Grid* grid);
+Grid copy_grid(const Grid* grid, Triangle* triangles);
+void destroy_grid(Grid* grid);
+bool intersect_grid(const Grid* grid, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx);
+bool occluded_grid(const Grid* grid, Ray ray, float max_distance);
+
+#endif
@@ -0,0 +1,188 @@
+#include "lbvh.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#define LBVH_LEAF_SIZE 4
+#define LBVH_TASK_THRESHOLD 4096       // Smaller inputs and subtrees stay on one thread
+#define LBVH_RADIX_BITS 8
+#define LBVH_RADIX_BUCKETS (1 << LBVH_RADIX_BITS)
+
+typedef struct {
+    BVH* bvh;
+    const uint32_t* codes;      // Sorted Morton codes, parallel to the triangle array
+} LBVHBuild;
+
+// Spread the low 10 bits of v so that two zero bits separate each of them
+static uint32_t expand_bits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Interleave a point normalized to [0, 1] into a 30-bit code
+static uint32_t get_morton_code(Vec3 p) {
+    float scale = (float)(1 << LBVH_MORTON_BITS);
+    uint32_t x = (uint32_t)fminf(fmaxf(p.x * scale, 0.0f), scale - 1.0f);
+    uint32_t y = (uint32_t)fminf(fmaxf(p.y * scale, 0.0f), scale - 1.0f);
+    uint32_t z = (uint32_t)fminf(fmaxf(p.z * scale, 0.0f), scale - 1.0f);
+    return (expand_bits(x) << 2) | (expand_bits(y) << 1) | expand_bits(z);
+}
+
+static Vec3 get_centroid(const Triangle* tri) {
+    return vec3_mul(vec3_add(vec3_add(tri->v0, tri->v1), tri->v2), 1.0f/3.0f);
+}
+
+// Stable LSD radix sort of code/index pairs, chunked per thread, result ends up in keys/values
+static void radix_sort_pairs(uint32_t* keys, uint32_t* values, uint32_t* keys_tmp, uint32_t* values_tmp, int count) {
+    int chunk_count = count >= LBVH_TASK_THRESHOLD ? omp_get_max_threads() : 1;
+    size_t* offsets = (size_t*)malloc((size_t)chunk_count * LBVH_RADIX_BUCKETS * sizeof(size_t));
+
+    for (int shift = 0; shift < 32; shift += LBVH_RADIX_BITS) {
+        memset(offsets, 0, (size_t)chunk_count * LBVH_RADIX_BUCKETS * sizeof(size_t));
+
+        // Histogram per chunk
+        #pragma omp parallel for schedule(static, 1) if(chunk_count > 1)
+        for (int c = 0; c < chunk_count; c++) {
+            size_t* histogram = &offsets[(size_t)c * LBVH_RADIX_BUCKETS];
+            int begin = (int)((long long)count * c / chunk_count);
+            int end = (int)((long long)count * (c + 1) / chunk_count);
+            for (int i = begin; i < end; i++) histogram[(keys[i] >> shift) & (LBVH_RADIX_BUCKETS - 1)]++;
+        }
+
+        // Bucket-major prefix sum keeps chunks in input order within every bucket
+        size_t total = 0;
+        for (int b = 0; b < LBVH_RADIX_BUCKETS; b++) {
+            for (int c = 0; c < chunk_count; c++) {
+                size_t bucket_count = offsets[(size_t)c * LBVH_RADIX_BUCKETS + b];
+                offsets[(size_t)c * LBVH_RADIX_BUCKETS + b] = total;
+                total += bucket_count;
+            }
+        }
+
+        #pragma omp parallel for schedule(static, 1) if(chunk_count > 1)
+        for (int c = 0; c < chunk_count; c++) {
+            size_t* offset = &offsets[(size_t)c * LBVH_RADIX_BUCKETS];
+            int begin = (int)((long long)count * c / chunk_count);
+            int end = (int)((long long)count * (c + 1) / chunk_count);
+            for (int i = begin; i < end; i++) {
+                size_t dst = offset[(keys[i] >> shift) & (LBVH_RADIX_BUCKETS - 1)]++;
+                keys_tmp[dst] = keys[i];
+                values_tmp[dst] = values[i];
+            }
+        }
+
+        uint32_t* swap = keys; keys = keys_tmp; keys_tmp = swap;
+        swap = values; values = values_tmp; values_tmp = swap;
+    }
+
+    // An even number of passes leaves the sorted data in the original arrays
+    free(offsets);
+}
+
+// First index of the right child, where the highest differing code bit flips
+static int find_split(const uint32_t* codes, int start, int count) {
+    uint32_t first = codes[start];
+    uint32_t last = codes[start + count - 1];
+    if (first == last) return start + count / 2;
+
+    int common_prefix = __builtin_clz(first ^ last);
+    int split = start;
+    int step = count - 1;
+    do {
+        step = (step + 1) >> 1;
+        int candidate = split + step;
+        if (candidate < start + count - 1 && __builtin_clz(first ^ codes[candidate]) > common_prefix) {
+            split = candidate;
+        }
+    } while (step > 1);
+    return split + 1;
+}
+
+static BVHNode* create_lbvh_node(const LBVHBuild* build, int start, int count) {
+    BVHNode* node = alloc_bvh_node(build->bvh);
+    node->start_idx = start;
+    node->triangle_count = count;
+    node->left = node->right = NULL;
+
+    if (count <= LBVH_LEAF_SIZE) {
+        const Triangle* triangles = build->bvh->triangles;
+        node->bounds = create_empty_aabb();
+        for (int i = 0; i < count; i++) {
+            node->bounds = expand_aabb(node->bounds, triangles[start + i].v0);
+            node->bounds = expand_aabb(node->bounds, triangles[start + i].v1);
+            node->bounds = expand_aabb(node->bounds, triangles[start + i].v2);
+        }
+        return node;
+    }
+
+    int mid = find_split(build->codes, start, count);
+    if (count >= LBVH_TASK_THRESHOLD) {
+        #pragma omp task
+        node->left = create_lbvh_node(build, start, mid - start);
+        node->right = create_lbvh_node(build, mid, start + count - mid);
+        #pragma omp taskwait
+    } else {
+        node->left = create_lbvh_node(build, start, mid - start);
+        node->right = create_lbvh_node(build, mid, start + count - mid);
+    }
+
+    // Refit on the way back up
+    node->bounds = merge_aabb(node->left->bounds, node->right->bounds);
+    return node;
+}
+
+void build_lbvh(BVH* bvh) {
+    int count = (int)bvh->triangle_count;
+    Triangle* triangles = bvh->triangles;
+    bool parallel = count >= LBVH_TASK_THRESHOLD;
+
+    // Centroid bounds span the Morton grid
+    float min_x = 1e30f, min_y = 1e30f, min_z = 1e30f;
+    float max_x = -1e30f, max_y = -1e30f, max_z = -1e30f;
+    #pragma omp parallel for if(parallel) reduction(min:min_x, min_y, min_z) reduction(max:max_x, max_y, max_z)
+    for (int i = 0; i < count; i++) {
+        Vec3 c = get_centroid(&triangles[i]);
+        min_x = fminf(min_x, c.x); min_y = fminf(min_y, c.y); min_z = fminf(min_z, c.z);
+        max_x = fmaxf(max_x, c.x); max_y = fmaxf(max_y, c.y); max_z = fmaxf(max_z, c.z);
+    }
+    Vec3 inv_extent = {
+        max_x > min_x ? 1.0f / (max_x - min_x) : 0.0f,
+        max_y > min_y ? 1.0f / (max_y - min_y) : 0.0f,
+        max_z > min_z ? 1.0f / (max_z - min_z) : 0.0f
+    };
+
+    uint32_t* codes = (uint32_t*)malloc(4 * (size_t)count * sizeof(uint32_t) + sizeof(uint32_t));
+    uint32_t* indices = codes + count;
+    uint32_t* codes_tmp = indices + count;
+    uint32_t* indices_tmp = codes_tmp + count;
+
+    #pragma omp parallel for if(parallel)
+    for (int i = 0; i < count; i++) {
+        Vec3 c = get_centroid(&triangles[i]);
+        codes[i] = get_morton_code((Vec3){
+            (c.x - min_x) * inv_extent.x,
+            (c.y - min_y) * inv_extent.y,
+            (c.z - min_z) * inv_extent.z
+        });
+        indices[i] = (uint32_t)i;
+    }
+    radix_sort_pairs(codes, indices, codes_tmp, indices_tmp, count);
+
+    // Leaves reference contiguous ranges, so the triangles follow the sorted order
+    Triangle* sorted = (Triangle*)malloc((size_t)count * sizeof(Triangle) + sizeof(Triangle));
+    #pragma omp parallel for if(parallel)
+    for (int i = 0; i < count; i++) sorted[i] = triangles[indices[i]];
+    memcpy(triangles, sorted, (size_t)count * sizeof(Triangle));
+    free(sorted);
+
+    LBVHBuild build = {bvh, codes};
+    #pragma omp parallel if(parallel)
+    #pragma omp single
+    bvh->root = create_lbvh_node(&build, 0, count);
+
+    free(codes);
+}
@@ -0,0 +1,11 @@
+#ifndef LBVH_H
+#define LBVH_H
+
+#include "bvh.h"
+
+#define LBVH_MORTON_BITS 10     // Bits per axis, giving 30-bit Morton codes
+
+// Linear BVH builder, sorts the triangles by centroid Morton code into a prepared node pool
+void build_lbvh(BVH* bvh);
+
+#endif
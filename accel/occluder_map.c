@@ -0,0 +1,142 @@
+#include "occluder_map.h"
+#include <string.h>
+#include <math.h>
+
+OccluderMap create_occluder_map(int resolution) {
+    OccluderMap map;
+    memset(&map, 0, sizeof(map));
+    map.resolution = resolution;
+    map.cell_start = (int*)calloc(resolution * resolution + 1, sizeof(int));
+    return map;
+}
+
+// Light-space rectangle and furthest depth of a world box
+static void project_bounds(const OccluderMap* map, AABB box,
+                           float* min_u, float* min_v, float* max_u, float* max_v, float* max_depth) {
+    *min_u = *min_v = 1e30f;
+    *max_u = *max_v = *max_depth = -1e30f;
+    for (int i = 0; i < 8; i++) {
+        Vec3 corner = {
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z
+        };
+        float u = vec3_dot(corner, map->axis_u);
+        float v = vec3_dot(corner, map->axis_v);
+        *min_u = fminf(*min_u, u);
+        *min_v = fminf(*min_v, v);
+        *max_u = fmaxf(*max_u, u);
+        *max_v = fmaxf(*max_v, v);
+        *max_depth = fmaxf(*max_depth, vec3_dot(corner, map->direction));
+    }
+
+    // Pad to stay conservative under rounding
+    *min_u -= 1e-3f;
+    *min_v -= 1e-3f;
+    *max_u += 1e-3f;
+    *max_v += 1e-3f;
+    *max_depth += 1e-3f;
+}
+
+static int cell_coordinate(float value, float min, float inv_cell, int resolution) {
+    int cell = (int)floorf((value - min) * inv_cell);
+    return cell < 0 ? 0 : (cell >= resolution ? resolution - 1 : cell);
+}
+
+void build_occluder_map(OccluderMap* map, Vec3 light_direction, const AABB* bounds, size_t count) {
+    int resolution = map->resolution;
+    int cell_count = resolution * resolution;
+
+    // Orthonormal basis around the light direction
+    map->direction = vec3_normalize(light_direction);
+    Vec3 helper = fabsf(map->direction.y) < 0.9f ? (Vec3){0, 1, 0} : (Vec3){1, 0, 0};
+    map->axis_u = vec3_normalize(vec3_cross(map->direction, helper));
+    map->axis_v = vec3_cross(map->direction, map->axis_u);
+
+    // Light-space extent of all occluders
+    float min_u = 1e30f, min_v = 1e30f, max_u = -1e30f, max_v = -1e30f;
+    for (size_t i = 0; i < count; i++) {
+        float u0, v0, u1, v1, depth;
+        project_bounds(map, bounds[i], &u0, &v0, &u1, &v1, &depth);
+        min_u = fminf(min_u, u0);
+        min_v = fminf(min_v, v0);
+        max_u = fmaxf(max_u, u1);
+        max_v = fmaxf(max_v, v1);
+    }
+    map->min_u = min_u;
+    map->min_v = min_v;
+    map->inv_cell_u = max_u > min_u ? resolution / (max_u - min_u) : 0.0f;
+    map->inv_cell_v = max_v > min_v ? resolution / (max_v - min_v) : 0.0f;
+
+    // Count entries per cell, then fill them in a second pass
+    memset(map->cell_start, 0, (cell_count + 1) * sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < count; i++) {
+            float u0, v0, u1, v1, depth;
+            project_bounds(map, bounds[i], &u0, &v0, &u1, &v1, &depth);
+            if (u0 > u1 || v0 > v1) continue;
+
+            int cu0 = cell_coordinate(u0, map->min_u, map->inv_cell_u, resolution);
+            int cv0 = cell_coordinate(v0, map->min_v, map->inv_cell_v, resolution);
+            int cu1 = cell_coordinate(u1, map->min_u, map->inv_cell_u, resolution);
+            int cv1 = cell_coordinate(v1, map->min_v, map->inv_cell_v, resolution);
+
+            for (int cv = cv0; cv <= cv1; cv++) {
+                for (int cu = cu0; cu <= cu1; cu++) {
+                    int cell = cv * resolution + cu;
+                    if (pass == 0) {
+                        map->cell_start[cell + 1]++;
+                    } else {
+                        int entry = map->cell_start[cell]++;
+                        map->entry_mesh[entry] = (int)i;
+                        map->entry_depth[entry] = depth;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            // Prefix sum into offsets and make room for all entries
+            for (int c = 0; c < cell_count; c++) {
+                map->cell_start[c + 1] += map->cell_start[c];
+            }
+            int total = map->cell_start[cell_count];
+            if (total > map->entry_capacity) {
+                map->entry_mesh = (int*)realloc(map->entry_mesh, total * sizeof(int));
+                map->entry_depth = (float*)realloc(map->entry_depth, total * sizeof(float));
+                map->entry_capacity = total;
+            }
+        }
+    }
+
+    // The fill pass advanced every offset to the end of its cell, shift them back
+    for (int c = cell_count; c > 0; c--) {
+        map->cell_start[c] = map->cell_start[c - 1];
+    }
+    map->cell_start[0] = 0;
+}
+
+OccluderCell find_occluder_cell(const OccluderMap* map, Vec3 point) {
+    OccluderCell cell = {NULL, NULL, 0, vec3_dot(point, map->direction)};
+
+    // Points outside the map cannot be reached by any occluder
+    int cu = (int)floorf((vec3_dot(point, map->axis_u) - map->min_u) * map->inv_cell_u);
+    int cv = (int)floorf((vec3_dot(point, map->axis_v) - map->min_v) * map->inv_cell_v);
+    if (cu < 0 || cv < 0 || cu >= map->resolution || cv >= map->resolution) return cell;
+
+    int index = cv * map->resolution + cu;
+    cell.meshes = &map->entry_mesh[map->cell_start[index]];
+    cell.depths = &map->entry_depth[map->cell_start[index]];
+    cell.count = map->cell_start[index + 1] - map->cell_start[index];
+    return cell;
+}
+
+void destroy_occluder_map(OccluderMap* map) {
+    free(map->cell_start);
+    free(map->entry_mesh);
+    free(map->entry_depth);
+    map->cell_start = NULL;
+    map->entry_mesh = NULL;
+    map->entry_depth = NULL;
+    map->entry_capacity = 0;
+}
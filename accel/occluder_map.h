@@ -0,0 +1,37 @@
+#ifndef OCCLUDER_MAP_H
+#define OCCLUDER_MAP_H
+
+#include "geometry/aabb.h"
+#include <stdlib.h>
+
+#define OCCLUDER_MAP_RESOLUTION 64
+
+typedef struct {
+    Vec3 direction;         // Normalized direction towards the light
+    Vec3 axis_u;            // Basis of the plane perpendicular to the light
+    Vec3 axis_v;
+    float min_u;
+    float min_v;
+    float inv_cell_u;
+    float inv_cell_v;
+    int resolution;
+    int* cell_start;        // Offsets into the entry arrays, resolution^2 + 1 values
+    int* entry_mesh;        // Mesh index of each occluder entry
+    float* entry_depth;     // Furthest extent of each occluder along the light direction
+    int entry_capacity;
+} OccluderMap;
+
+typedef struct {
+    const int* meshes;
+    const float* depths;
+    int count;
+    float depth;            // Depth of the queried point along the light direction
+} OccluderCell;
+
+// Occluder map operations
+OccluderMap create_occluder_map(int resolution);
+void build_occluder_map(OccluderMap* map, Vec3 light_direction, const AABB* bounds, size_t count);
+OccluderCell find_occluder_cell(const OccluderMap* map, Vec3 point);
+void destroy_occluder_map(OccluderMap* map);
+
+#endif
@@ -0,0 +1,494 @@
+#include "paged.h"
+#include "math/ray.h"
+#include "utils/hash.h"
+#include "utils/stats.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + PAGED_PAGE_ALIGNMENT - 1) / PAGED_PAGE_ALIGNMENT * PAGED_PAGE_ALIGNMENT;
+}
+
+static size_t get_page_size(const PagedPage* page) {
+    return (size_t)page->node_count * sizeof(PagedNode) + (size_t)page->triangle_count * sizeof(Triangle);
+}
+
+static bool is_page_root(const BVHNode* node) {
+    return node->triangle_count <= PAGED_PAGE_TRIANGLES || (!node->left && !node->right);
+}
+
+static int count_subtree_nodes(const BVHNode* node) {
+    if (!node->left && !node->right) return 1;
+    return 1 + count_subtree_nodes(node->left) + count_subtree_nodes(node->right);
+}
+
+// Upper levels in depth-first order, every small enough subtree becomes the next page
+static int32_t add_top_node(const BVHNode* node, PagedNode* top, int* top_count, const BVHNode** roots, int* page_count) {
+    int32_t index = (*top_count)++;
+    top[index].bounds = node->bounds;
+    top[index].left = top[index].right = -1;
+    top[index].count = node->triangle_count;
+    if (is_page_root(node)) {
+        top[index].start = (*page_count)++;
+        roots[top[index].start] = node;
+        return index;
+    }
+    top[index].start = node->start_idx;
+    int32_t left = add_top_node(node->left, top, top_count, roots, page_count);
+    int32_t right = add_top_node(node->right, top, top_count, roots, page_count);
+    top[index].left = left;
+    top[index].right = right;
+    return index;
+}
+
+// Page nodes are indexed within the page, leaves address the page's triangles
+static int32_t flatten_page_node(const BVHNode* node, int first_triangle, PagedNode* nodes, int* node_count) {
+    int32_t index = (*node_count)++;
+    nodes[index].bounds = node->bounds;
+    nodes[index].left = nodes[index].right = -1;
+    nodes[index].start = node->start_idx - first_triangle;
+    nodes[index].count = node->triangle_count;
+    if (node->left || node->right) {
+        int32_t left = flatten_page_node(node->left, first_triangle, nodes, node_count);
+        int32_t right = flatten_page_node(node->right, first_triangle, nodes, node_count);
+        nodes[index].left = left;
+        nodes[index].right = right;
+    }
+    return index;
+}
+
+// Header, top nodes and page table, then every page on an aligned offset
+static bool write_paged_stream(FILE* fp, BVH* bvh) {
+    complete_bvh(bvh);
+    if (!bvh->root) return false;
+
+    PagedNode* top = (PagedNode*)malloc(bvh->node_count * sizeof(PagedNode));
+    const BVHNode** roots = (const BVHNode**)malloc(bvh->node_count * sizeof(const BVHNode*));
+    int top_count = 0, page_count = 0;
+    add_top_node(bvh->root, top, &top_count, roots, &page_count);
+
+    PagedHeader header = {
+        PAGED_FILE_MAGIC, PAGED_FILE_VERSION, bvh->triangle_count, (uint32_t)top_count, (uint32_t)page_count, 0,
+        hash_bytes(bvh->triangles, bvh->triangle_count * sizeof(Triangle), HASH_SEED)
+    };
+    PagedPage* pages = (PagedPage*)calloc(page_count, sizeof(PagedPage));
+    uint64_t offset = align_offset(sizeof(PagedHeader) + top_count * sizeof(PagedNode) + page_count * sizeof(PagedPage));
+    for (int p = 0; p < page_count; p++) {
+        pages[p].offset = offset;
+        pages[p].node_count = count_subtree_nodes(roots[p]);
+        pages[p].triangle_count = roots[p]->triangle_count;
+        pages[p].first_triangle = roots[p]->start_idx;
+        if (get_page_size(&pages[p]) > header.page_bytes) header.page_bytes = get_page_size(&pages[p]);
+        offset = align_offset(offset + get_page_size(&pages[p]));
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(top, sizeof(PagedNode), top_count, fp) == (size_t)top_count &&
+              fwrite(pages, sizeof(PagedPage), page_count, fp) == (size_t)page_count;
+
+    PagedNode* nodes = (PagedNode*)malloc(header.page_bytes > 0 ? header.page_bytes : 1);
+    for (int p = 0; ok && p < page_count; p++) {
+        int node_count = 0;
+        flatten_page_node(roots[p], pages[p].first_triangle, nodes, &node_count);
+        ok = fseeko(fp, (off_t)pages[p].offset, SEEK_SET) == 0 &&
+             fwrite(nodes, sizeof(PagedNode), node_count, fp) == (size_t)node_count &&
+             fwrite(bvh->triangles + pages[p].first_triangle, sizeof(Triangle), pages[p].triangle_count, fp) ==
+                 (size_t)pages[p].triangle_count;
+    }
+
+    free(nodes);
+    free(pages);
+    free(roots);
+    free(top);
+    return ok;
+}
+
+// Completes the BVH first, the file keeps the BVH's triangle order
+bool write_paged_geometry(const char* filename, BVH* bvh) {
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return false;
+    }
+    bool ok = write_paged_stream(fp, bvh);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) fprintf(stderr, "Failed to write paged geometry %s\n", filename);
+    return ok;
+}
+
+// Takes ownership of fd. Only the header, top nodes and page table are read up front.
+static PagedGeometry* map_paged_geometry(int fd, size_t budget_bytes, const char* name) {
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PagedHeader)) {
+        fprintf(stderr, "Failed to read paged geometry %s\n", name);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    unsigned char* map = (unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map paged geometry %s\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    PagedHeader header;
+    memcpy(&header, map, sizeof(header));
+    size_t tables_size = sizeof(PagedHeader) + (size_t)header.top_node_count * sizeof(PagedNode) +
+                         (size_t)header.page_count * sizeof(PagedPage);
+    bool valid = header.magic == PAGED_FILE_MAGIC && header.version == PAGED_FILE_VERSION &&
+                 header.top_node_count > 0 && header.page_count > 0 && tables_size <= (size_t)st.st_size;
+
+    // Pages must cover the triangles in order, so a triangle index finds its page by bisection
+    const PagedPage* pages = (const PagedPage*)(map + sizeof(PagedHeader) + header.top_node_count * sizeof(PagedNode));
+    uint64_t next_triangle = 0;
+    for (uint32_t p = 0; valid && p < header.page_count; p++) {
+        valid = pages[p].first_triangle == (int64_t)next_triangle && pages[p].triangle_count >= 0 &&
+                get_page_size(&pages[p]) <= header.page_bytes &&
+                pages[p].offset + get_page_size(&pages[p]) <= (uint64_t)st.st_size;
+        next_triangle += pages[p].triangle_count;
+    }
+    const PagedNode* top = (const PagedNode*)(map + sizeof(PagedHeader));
+    for (uint32_t n = 0; valid && n < header.top_node_count; n++) {
+        valid = top[n].left < 0 ? top[n].start >= 0 && (uint32_t)top[n].start < header.page_count
+                                : (uint32_t)top[n].left < header.top_node_count && top[n].right >= 0 &&
+                                  (uint32_t)top[n].right < header.top_node_count;
+    }
+    if (!valid || next_triangle != header.triangle_count) {
+        fprintf(stderr, "%s is not valid paged geometry\n", name);
+        munmap(map, st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    PagedGeometry* geometry = (PagedGeometry*)calloc(1, sizeof(PagedGeometry));
+    geometry->fd = fd;
+    geometry->map = map;
+    geometry->map_size = st.st_size;
+    geometry->header = header;
+    geometry->top_nodes = (PagedNode*)malloc(header.top_node_count * sizeof(PagedNode));
+    memcpy(geometry->top_nodes, top, header.top_node_count * sizeof(PagedNode));
+    geometry->pages = (PagedPage*)malloc(header.page_count * sizeof(PagedPage));
+    memcpy(geometry->pages, pages, header.page_count * sizeof(PagedPage));
+    geometry->page_slots = (int*)malloc(header.page_count * sizeof(int));
+    for (uint32_t p = 0; p < header.page_count; p++) geometry->page_slots[p] = -1;
+
+    // Every render thread pins at most one page at a time, one spare slot keeps misses from waiting
+    int budget_slots = (int)(budget_bytes / (header.page_bytes > 0 ? header.page_bytes : 1));
+    int min_slots = omp_get_max_threads() + 1;
+    if (min_slots > (int)header.page_count) min_slots = header.page_count;
+    if (budget_slots > (int)header.page_count) budget_slots = header.page_count;
+    if (budget_slots < min_slots) {
+        fprintf(stderr, "Page budget of %zu bytes holds fewer pages than render threads, using %d pages of %llu bytes\n",
+                budget_bytes, min_slots, (unsigned long long)header.page_bytes);
+        budget_slots = min_slots;
+    }
+    geometry->slot_count = budget_slots;
+    geometry->slots = (PageSlot*)calloc(budget_slots, sizeof(PageSlot));
+    for (int s = 0; s < budget_slots; s++) geometry->slots[s].page = -1;
+    pthread_mutex_init(&geometry->lock, NULL);
+    geometry->references = 1;
+    return geometry;
+}
+
+PagedGeometry* open_paged_geometry(const char* filename, size_t budget_bytes) {
+    return map_paged_geometry(open(filename, O_RDONLY), budget_bytes, filename);
+}
+
+// Builds a BVH and pages it out to an unlinked temporary file, the triangles end up in BVH order
+PagedGeometry* create_paged_geometry(Triangle* triangles, size_t count, BVHBuilder builder, size_t budget_bytes) {
+    BVH bvh = create_bvh_with_builder(triangles, count, builder);
+    FILE* fp = tmpfile();
+    bool ok = fp && write_paged_stream(fp, &bvh) && fflush(fp) == 0;
+    destroy_bvh(&bvh);
+
+    PagedGeometry* geometry = NULL;
+    if (ok) geometry = map_paged_geometry(dup(fileno(fp)), budget_bytes, "temporary file");
+    else fprintf(stderr, "Failed to write temporary paged geometry\n");
+    if (fp) fclose(fp);
+    return geometry;
+}
+
+PagedGeometry* retain_paged_geometry(PagedGeometry* geometry) {
+    __atomic_fetch_add(&geometry->references, 1, __ATOMIC_RELAXED);
+    return geometry;
+}
+
+void release_paged_geometry(PagedGeometry* geometry) {
+    if (!geometry || __atomic_sub_fetch(&geometry->references, 1, __ATOMIC_ACQ_REL) > 0) return;
+    for (int s = 0; s < geometry->slot_count; s++) free(geometry->slots[s].data);
+    free(geometry->slots);
+    free(geometry->page_slots);
+    free(geometry->pages);
+    free(geometry->top_nodes);
+    pthread_mutex_destroy(&geometry->lock);
+    munmap(geometry->map, geometry->map_size);
+    close(geometry->fd);
+    free(geometry);
+}
+
+// Pins fail while the slot is refilled or once it holds another page
+static bool pin_slot(PageSlot* slot, int page) {
+    int pins = __atomic_load_n(&slot->pins, __ATOMIC_ACQUIRE);
+    while (pins >= 0) {
+        if (__atomic_compare_exchange_n(&slot->pins, &pins, pins + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            if (__atomic_load_n(&slot->page, __ATOMIC_ACQUIRE) == page) {
+                __atomic_store_n(&slot->referenced, 1, __ATOMIC_RELAXED);
+                return true;
+            }
+            __atomic_fetch_sub(&slot->pins, 1, __ATOMIC_RELEASE);
+            return false;
+        }
+    }
+    return false;
+}
+
+// Clock sweep under the lock, recently hit slots get a second chance and pinned ones are skipped
+static int claim_victim_slot(PagedGeometry* geometry) {
+    for (;;) {
+        for (int i = 0; i < 2 * geometry->slot_count; i++) {
+            int index = geometry->clock_hand;
+            PageSlot* slot = &geometry->slots[index];
+            geometry->clock_hand = (index + 1) % geometry->slot_count;
+            if (__atomic_exchange_n(&slot->referenced, 0, __ATOMIC_RELAXED)) continue;
+            int expected = 0;
+            if (__atomic_compare_exchange_n(&slot->pins, &expected, -1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return index;
+            }
+        }
+        // Every slot is pinned, readers release theirs without the lock
+        sched_yield();
+    }
+}
+
+// Returns the pinned slot holding the page, loading it from the mapping on a miss
+static int acquire_page(PagedGeometry* geometry, int page) {
+    for (;;) {
+        int index = __atomic_load_n(&geometry->page_slots[page], __ATOMIC_ACQUIRE);
+        if (index >= 0 && pin_slot(&geometry->slots[index], page)) {
+            __atomic_fetch_add(&geometry->stats.hits, 1, __ATOMIC_RELAXED);
+            return index;
+        }
+        if (index == -2) {
+            // Another thread is loading this page
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&geometry->lock);
+        if (__atomic_load_n(&geometry->page_slots[page], __ATOMIC_ACQUIRE) != -1) {
+            pthread_mutex_unlock(&geometry->lock);
+            continue;
+        }
+        index = claim_victim_slot(geometry);
+        PageSlot* slot = &geometry->slots[index];
+        if (slot->page >= 0) {
+            __atomic_store_n(&geometry->page_slots[slot->page], -1, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&geometry->stats.evictions, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&slot->page, -1, __ATOMIC_RELAXED);
+        __atomic_store_n(&geometry->page_slots[page], -2, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&geometry->lock);
+
+        // Copy outside the lock, then drop the mapped pages so only the cache counts against memory
+        const PagedPage* entry = &geometry->pages[page];
+        if (!slot->data) slot->data = (unsigned char*)malloc(geometry->header.page_bytes);
+        memcpy(slot->data, geometry->map + entry->offset, get_page_size(entry));
+        madvise(geometry->map + entry->offset, get_page_size(entry), MADV_DONTNEED);
+
+        __atomic_store_n(&slot->page, page, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->referenced, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&geometry->page_slots[page], index, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->pins, 1, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&geometry->stats.misses, 1, __ATOMIC_RELAXED);
+        return index;
+    }
+}
+
+static void release_page(PagedGeometry* geometry, int index) {
+    __atomic_fetch_sub(&geometry->slots[index].pins, 1, __ATOMIC_RELEASE);
+}
+
+// Same traversal and tie breaking as intersect_bvh, so paged and resident meshes render alike
+static bool intersect_page_node(const PagedNode* nodes, const Triangle* triangles, int first_triangle, int index,
+                                Ray ray, const SlabRay* slab, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    const PagedNode* node = &nodes[index];
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    STATS_INC(node_visits);
+
+    if (node->left < 0) {
+        bool hit = false;
+        float closest_t = *t_out;
+        for (int i = node->start; i < node->start + node->count; i++) {
+            float t, u, v;
+            if (ray_triangle_intersect(ray, triangles[i].v0, triangles[i].v1, triangles[i].v2, &t, &u, &v) &&
+                t < closest_t) {
+                closest_t = t;
+                *t_out = t;
+                *u_out = u;
+                *v_out = v;
+                *tri_idx = first_triangle + i;
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    float t1 = 1e30f, t2 = 1e30f;
+    float u1, v1, u2, v2;
+    int idx1, idx2;
+    bool hit1 = intersect_page_node(nodes, triangles, first_triangle, node->left, ray, slab, &t1, &u1, &v1, &idx1);
+    bool hit2 = intersect_page_node(nodes, triangles, first_triangle, node->right, ray, slab, &t2, &u2, &v2, &idx2);
+    if (hit1 && (!hit2 || t1 < t2)) {
+        *t_out = t1;
+        *u_out = u1;
+        *v_out = v1;
+        *tri_idx = idx1;
+        return true;
+    }
+    if (hit2) {
+        *t_out = t2;
+        *u_out = u2;
+        *v_out = v2;
+        *tri_idx = idx2;
+        return true;
+    }
+    return false;
+}
+
+static bool intersect_top_node(PagedGeometry* geometry, int index, Ray ray, const SlabRay* slab,
+                               float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    const PagedNode* node = &geometry->top_nodes[index];
+    if (node->left < 0) {
+        // Pages are only loaded for rays that reach their bounds
+        STATS_INC(box_tests);
+        if (!slab_ray_intersect(slab, &node->bounds)) return false;
+        int slot = acquire_page(geometry, node->start);
+        const PagedPage* page = &geometry->pages[node->start];
+        const PagedNode* nodes = (const PagedNode*)geometry->slots[slot].data;
+        bool hit = intersect_page_node(nodes, (const Triangle*)(nodes + page->node_count), page->first_triangle, 0,
+                                       ray, slab, t_out, u_out, v_out, tri_idx);
+        release_page(geometry, slot);
+        return hit;
+    }
+
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    STATS_INC(node_visits);
+
+    float t1 = 1e30f, t2 = 1e30f;
+    float u1, v1, u2, v2;
+    int idx1, idx2;
+    bool hit1 = intersect_top_node(geometry, node->left, ray, slab, &t1, &u1, &v1, &idx1);
+    bool hit2 = intersect_top_node(geometry, node->right, ray, slab, &t2, &u2, &v2, &idx2);
+    if (hit1 && (!hit2 || t1 < t2)) {
+        *t_out = t1;
+        *u_out = u1;
+        *v_out = v1;
+        *tri_idx = idx1;
+        return true;
+    }
+    if (hit2) {
+        *t_out = t2;
+        *u_out = u2;
+        *v_out = v2;
+        *tri_idx = idx2;
+        return true;
+    }
+    return false;
+}
+
+bool intersect_paged_geometry(const PagedGeometry* geometry, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx) {
+    SlabRay slab = create_slab_ray(ray);
+    return intersect_top_node((PagedGeometry*)geometry, 0, ray, &slab, t_out, u_out, v_out, tri_idx);
+}
+
+static bool occluded_page_node(const PagedNode* nodes, const Triangle* triangles, int index, Ray ray,
+                               const SlabRay* slab, float max_distance) {
+    const PagedNode* node = &nodes[index];
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    STATS_INC(node_visits);
+
+    if (node->left < 0) {
+        for (int i = node->start; i < node->start + node->count; i++) {
+            float t, u, v;
+            if (ray_triangle_intersect(ray, triangles[i].v0, triangles[i].v1, triangles[i].v2, &t, &u, &v) &&
+                t < max_distance) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return occluded_page_node(nodes, triangles, node->left, ray, slab, max_distance) ||
+           occluded_page_node(nodes, triangles, node->right, ray, slab, max_distance);
+}
+
+static bool occluded_top_node(PagedGeometry* geometry, int index, Ray ray, const SlabRay* slab, float max_distance) {
+    const PagedNode* node = &geometry->top_nodes[index];
+    STATS_INC(box_tests);
+    if (!slab_ray_intersect(slab, &node->bounds)) return false;
+    if (node->left < 0) {
+        int slot = acquire_page(geometry, node->start);
+        const PagedNode* nodes = (const PagedNode*)geometry->slots[slot].data;
+        bool hit = occluded_page_node(nodes, (const Triangle*)(nodes + geometry->pages[node->start].node_count), 0,
+                                      ray, slab, max_distance);
+        release_page(geometry, slot);
+        return hit;
+    }
+    STATS_INC(node_visits);
+    return occluded_top_node(geometry, node->left, ray, slab, max_distance) ||
+           occluded_top_node(geometry, node->right, ray, slab, max_distance);
+}
+
+bool occluded_paged_geometry(const PagedGeometry* geometry, Ray ray, float max_distance) {
+    SlabRay slab = create_slab_ray(ray);
+    return occluded_top_node((PagedGeometry*)geometry, 0, ray, &slab, max_distance);
+}
+
+// Shading reads single triangles through the same cache as traversal
+void get_paged_triangle(const PagedGeometry* geometry, int index, Triangle* triangle) {
+    int low = 0, high = (int)geometry->header.page_count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (geometry->pages[mid].first_triangle <= index) low = mid;
+        else high = mid - 1;
+    }
+    PagedGeometry* cache = (PagedGeometry*)geometry;
+    int slot = acquire_page(cache, low);
+    const PagedNode* nodes = (const PagedNode*)cache->slots[slot].data;
+    const Triangle* triangles = (const Triangle*)(nodes + geometry->pages[low].node_count);
+    *triangle = triangles[index - geometry->pages[low].first_triangle];
+    release_page(cache, slot);
+}
+
+size_t get_paged_geometry_node_count(const PagedGeometry* geometry) {
+    size_t count = geometry->header.top_node_count;
+    for (uint32_t p = 0; p < geometry->header.page_count; p++) count += geometry->pages[p].node_count;
+    return count;
+}
+
+// Resident bytes: top nodes, page table and the cache slots filled so far
+size_t get_paged_geometry_memory(const PagedGeometry* geometry) {
+    size_t bytes = geometry->header.top_node_count * sizeof(PagedNode) +
+                   geometry->header.page_count * (sizeof(PagedPage) + sizeof(int)) +
+                   geometry->slot_count * sizeof(PageSlot);
+    for (int s = 0; s < geometry->slot_count; s++) {
+        if (geometry->slots[s].data) bytes += geometry->header.page_bytes;
+    }
+    return bytes;
+}
+
+PageCacheStats get_page_cache_stats(const PagedGeometry* geometry) {
+    PageCacheStats stats;
+    stats.hits = __atomic_load_n(&geometry->stats.hits, __ATOMIC_RELAXED);
+    stats.misses = __atomic_load_n(&geometry->stats.misses, __ATOMIC_RELAXED);
+    stats.evictions = __atomic_load_n(&geometry->stats.evictions, __ATOMIC_RELAXED);
+    return stats;
+}
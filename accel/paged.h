@@ -0,0 +1,85 @@
+#ifndef PAGED_H
+#define PAGED_H
+
+#include "bvh.h"
+#include <stdint.h>
+#include <pthread.h>
+
+#define PAGED_FILE_MAGIC 0x47505452u   // "RTPG"
+#define PAGED_FILE_VERSION 1
+#define PAGED_PAGE_TRIANGLES 4096       // Subtrees up to this many triangles are stored as one page
+#define PAGED_PAGE_ALIGNMENT 4096       // Pages start on file system pages so they can be dropped from the mapping
+#define PAGED_DEFAULT_BUDGET ((size_t)64 << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t triangle_count;
+    uint32_t top_node_count;
+    uint32_t page_count;
+    uint64_t page_bytes;        // Largest page, the size of one cache slot
+    uint64_t content_hash;      // Triangles in file order
+} PagedHeader;
+
+// Top nodes with left < 0 stand for the page start, page nodes with left < 0 are leaves
+// over the page triangles [start, start + count)
+typedef struct {
+    AABB bounds;
+    int32_t left;
+    int32_t right;
+    int32_t start;
+    int32_t count;
+} PagedNode;
+
+typedef struct {
+    uint64_t offset;            // Page position in the file, nodes first, then triangles
+    int32_t node_count;
+    int32_t triangle_count;
+    int32_t first_triangle;     // Mesh index of the page's first triangle
+    int32_t reserved;
+} PagedPage;
+
+typedef struct {
+    int page;                   // Page held by the slot, -1 when empty
+    int pins;                   // Threads reading the slot, -1 while it is refilled
+    int referenced;             // Clock bit, set on every hit
+    unsigned char* data;        // Allocated on first use
+} PageSlot;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} PageCacheStats;
+
+// Triangles and lower BVH levels stay in a memory-mapped file, pages are copied into a budgeted cache
+typedef struct {
+    int fd;
+    unsigned char* map;
+    size_t map_size;
+    PagedHeader header;
+    PagedNode* top_nodes;       // Upper levels, always resident
+    PagedPage* pages;
+    int* page_slots;            // Slot of every page, -1 when not resident, -2 while loading
+    PageSlot* slots;
+    int slot_count;
+    int clock_hand;
+    pthread_mutex_t lock;       // Serializes slot selection, hits only touch atomics
+    PageCacheStats stats;       // Updated atomically
+    int references;             // Accel copies sharing the cache
+} PagedGeometry;
+
+// Paged geometry operations, write takes a BVH over the mesh triangles and keeps its triangle order
+bool write_paged_geometry(const char* filename, BVH* bvh);
+PagedGeometry* open_paged_geometry(const char* filename, size_t budget_bytes);
+PagedGeometry* create_paged_geometry(Triangle* triangles, size_t count, BVHBuilder builder, size_t budget_bytes);
+PagedGeometry* retain_paged_geometry(PagedGeometry* geometry);
+void release_paged_geometry(PagedGeometry* geometry);
+bool intersect_paged_geometry(const PagedGeometry* geometry, Ray ray, float* t_out, float* u_out, float* v_out, int* tri_idx);
+bool occluded_paged_geometry(const PagedGeometry* geometry, Ray ray, float max_distance);
+void get_paged_triangle(const PagedGeometry* geometry, int index, Triangle* triangle);
+size_t get_paged_geometry_node_count(const PagedGeometry* geometry);
+size_t get_paged_geometry_memory(const PagedGeometry* geometry);
+PageCacheStats get_page_cache_stats(const PagedGeometry* geometry);
+
+#endif
@@ -0,0 +1,488 @@
+#include "scene.h"
+#include "demo.h"
+#include "accel/accel.h"
+#include <string.h>
+#include <omp.h>
+
+#define MAX_SYNTHETIC_SCENES 8
+#define MAX_BENCH_ACCELS 8
+
+typedef struct {
+    int width;
+    int height;
+    int frames;
+    int repeats;
+    unsigned int seed;
+    bool incremental;
+    bool occluder_map;
+    BVHBuilder bvh_builder;
+    AccelType accels[MAX_BENCH_ACCELS]; // Per mesh index, the last one also covers the remaining meshes
+    int accel_count;
+    int light_count;            // Random point lights added to every scene
+} BenchConfig;
+
+typedef struct {
+    char name[64];
+    size_t triangle_count;
+    double load_ms;
+    double bvh_build_ms;
+    double accel_kb;            // Acceleration structure memory of all meshes
+    double primary_rays_per_sec;
+    double shadow_rays_per_sec;
+    double frame_ms_avg;
+    double frame_ms_min;
+    double frame_ms_max;
+    double upscale_ms;
+    double encode_ms;
+} BenchResult;
+
+// Fixed-seed generator so synthetic scenes are identical between runs
+static float next_random(unsigned int* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+static Triangle make_triangle(Vec3 v0, Vec3 v1, Vec3 v2) {
+    Vec3 normal = vec3_normalize(vec3_cross(vec3_sub(v1, v0), vec3_sub(v2, v0)));
+    return (Triangle){
+        v0, v1, v2,
+        {0, 0}, {1, 0}, {0, 1},
+        normal, normal, normal
+    };
+}
+
+// Random triangle soup above a ground quad
+static void setup_synthetic_scene(Scene* scene, size_t triangle_count, unsigned int seed) {
+    set_scene_camera(scene,
+        (Vec3){-3.0f, 3.0f, -3.0f},
+        (Vec3){0.0f, 0.0f, 0.0f},
+        (Vec3){0.0f, 1.0f, 0.0f},
+        60.0f
+    );
+    set_scene_light(scene, (Vec3){1.0f, 1.0f, -1.0f}, (Vec3){1.4f, 1.4f, 1.4f});
+
+    Triangle* triangles = (Triangle*)malloc(triangle_count * sizeof(Triangle));
+    float size = 4.0f / cbrtf((float)triangle_count);
+    unsigned int state = seed;
+    for (size_t i = 0; i < triangle_count; i++) {
+        Vec3 center = {
+            -1.5f + 3.0f * next_random(&state),
+             0.2f + 2.0f * next_random(&state),
+            -1.5f + 3.0f * next_random(&state)
+        };
+        Vec3 corners[3];
+        for (int c = 0; c < 3; c++) {
+            corners[c] = vec3_add(center, (Vec3){
+                size * (next_random(&state) - 0.5f),
+                size * (next_random(&state) - 0.5f),
+                size * (next_random(&state) - 0.5f)
+            });
+        }
+        triangles[i] = make_triangle(corners[0], corners[1], corners[2]);
+    }
+    add_mesh_to_scene(scene, create_mesh_from_triangles(triangles, triangle_count));
+    free(triangles);
+
+    Triangle ground[2] = {
+        make_triangle((Vec3){-9, 0, -9}, (Vec3){-9, 0, 9}, (Vec3){9, 0, 9}),
+        make_triangle((Vec3){-9, 0, -9}, (Vec3){9, 0, 9}, (Vec3){9, 0, -9})
+    };
+    add_mesh_to_scene(scene, create_mesh_from_triangles(ground, 2));
+}
+
+// Scatter point lights over the scene, total power stays the same for any count
+static void add_random_lights(Scene* scene, int count, unsigned int seed) {
+    unsigned int state = seed ^ 0x9e3779b9u;
+    for (int i = 0; i < count; i++) {
+        Vec3 position = {
+            -3.0f + 6.0f * next_random(&state),
+             0.5f + 2.5f * next_random(&state),
+            -3.0f + 6.0f * next_random(&state)
+        };
+        float intensity = 4.0f / count;
+        add_light_to_scene(scene, create_point_light(position, (Vec3){intensity, intensity * 0.9f, intensity * 0.7f}));
+    }
+}
+
+// Spin the triangle soup so every frame has real work
+static void animate_synthetic_scene(Scene* scene, int frame) {
+    set_mesh_rotation(&scene->meshes[0], (Vec3){0, frame * 0.05f, 0});
+}
+
+static AccelType get_bench_accel(const BenchConfig* config, size_t mesh_index) {
+    return config->accels[mesh_index < (size_t)config->accel_count ? mesh_index : (size_t)config->accel_count - 1];
+}
+
+static void bench_bvh_build(const Scene* scene, const BenchConfig* config, BenchResult* result) {
+    result->bvh_build_ms = 1e30;
+    for (int r = 0; r < config->repeats; r++) {
+        double total = 0.0;
+        for (size_t m = 0; m < scene->mesh_count; m++) {
+            const Mesh* mesh = &scene->meshes[m];
+            Triangle* copy = (Triangle*)malloc(mesh->triangle_count * sizeof(Triangle));
+            memcpy(copy, mesh->triangles, mesh->triangle_count * sizeof(Triangle));
+
+            double start = omp_get_wtime();
+            Accel accel = create_accel(get_bench_accel(config, m), copy, mesh->triangle_count, config->bvh_builder);
+            total += omp_get_wtime() - start;
+
+            destroy_accel(&accel);
+            free(copy);
+        }
+        if (total * 1000.0 < result->bvh_build_ms) result->bvh_build_ms = total * 1000.0;
+    }
+}
+
+static void bench_rays(Scene* scene, const BenchConfig* config, BenchResult* result) {
+    int pixel_count = scene->width * scene->height;
+    float aspect = (float)scene->width / scene->height;
+    Ray* shadow_rays = (Ray*)malloc(pixel_count * sizeof(Ray));
+    int shadow_count = 0;
+    double best_primary = 1e30, best_shadow = 1e30;
+    update_scene_acceleration(scene);
+
+    for (int r = 0; r < config->repeats; r++) {
+        // Primary rays, keeping hit points for the shadow pass
+        shadow_count = 0;
+        double start = omp_get_wtime();
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < scene->height; y++) {
+            for (int x = 0; x < scene->width; x++) {
+                Ray ray = get_camera_ray(&scene->camera,
+                                         (x + 0.5f) / scene->width,
+                                         (y + 0.5f) / scene->height,
+                                         aspect);
+                SceneHit hit;
+                if (intersect_scene(scene, ray, &hit)) {
+                    Vec3 point = vec3_add(ray.origin, vec3_mul(ray.direction, hit.t - 0.001f));
+                    int slot;
+                    #pragma omp atomic capture
+                    slot = shadow_count++;
+                    shadow_rays[slot] = (Ray){point, scene->light.direction};
+                }
+            }
+        }
+        double primary = omp_get_wtime() - start;
+        if (primary < best_primary) best_primary = primary;
+
+        // Shadow rays towards the light
+        start = omp_get_wtime();
+        int occluded = 0;
+        #pragma omp parallel for schedule(dynamic, 256) reduction(+:occluded)
+        for (int i = 0; i < shadow_count; i++) {
+            occluded += occluded_scene(scene, shadow_rays[i]);
+        }
+        double shadow = omp_get_wtime() - start;
+        if (shadow < best_shadow) best_shadow = shadow;
+        (void)occluded;
+    }
+
+    result->primary_rays_per_sec = pixel_count / best_primary;
+    result->shadow_rays_per_sec = shadow_count > 0 ? shadow_count / best_shadow : 0.0;
+    free(shadow_rays);
+}
+
+static void bench_frames(Scene* scene, bool synthetic, BenchResult* result) {
+    result->frame_ms_avg = 0.0;
+    result->frame_ms_min = 1e30;
+    result->frame_ms_max = 0.0;
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        if (synthetic) animate_synthetic_scene(scene, frame);
+        else animate_demo_scene(scene, frame);
+
+        double start = omp_get_wtime();
+        render_scene(scene);
+        double ms = (omp_get_wtime() - start) * 1000.0;
+        next_frame(scene);
+
+        result->frame_ms_avg += ms / scene->frame_count;
+        if (ms < result->frame_ms_min) result->frame_ms_min = ms;
+        if (ms > result->frame_ms_max) result->frame_ms_max = ms;
+    }
+}
+
+static void bench_output(Scene* scene, BenchResult* result) {
+    uint32_t* argb = (uint32_t*)malloc(scene->output_width * scene->output_height * sizeof(uint32_t));
+    double upscale = 0.0;
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        double start = omp_get_wtime();
+        upscale_frame(scene, frame, argb);
+        upscale += omp_get_wtime() - start;
+    }
+    free(argb);
+
+    // save_scene upscales again, the remainder is encoding and writing
+    const char* filename = "bench_tmp.webp";
+    double start = omp_get_wtime();
+    save_scene(scene, filename);
+    double total = omp_get_wtime() - start;
+    remove(filename);
+
+    result->upscale_ms = upscale * 1000.0 / scene->frame_count;
+    result->encode_ms = (total - upscale) * 1000.0 / scene->frame_count;
+    if (result->encode_ms < 0.0) result->encode_ms = 0.0;
+}
+
+// Enough duration at 24 fps for the requested frame count
+static Scene create_bench_scene(const BenchConfig* config) {
+    int duration_ms = (config->frames * 1000 + 23) / 24;
+    Scene scene = create_scene(config->width, config->height, duration_ms, 24, 1.0f);
+    set_scene_incremental(&scene, config->incremental);
+    set_scene_occluder_map(&scene, config->occluder_map);
+    return scene;
+}
+
+static void setup_bench_scene(Scene* scene, const BenchConfig* config, size_t synthetic_triangles) {
+    if (synthetic_triangles > 0) {
+        setup_synthetic_scene(scene, synthetic_triangles, config->seed);
+    } else {
+        setup_demo_scene(scene);
+        animate_demo_scene(scene, 0);
+    }
+    add_random_lights(scene, config->light_count, config->seed);
+}
+
+static void destroy_bench_scene(Scene* scene) {
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        destroy_mesh(&scene->meshes[m]);
+    }
+    destroy_scene(scene);
+}
+
+static BenchResult run_case(const BenchConfig* config, size_t synthetic_triangles) {
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+    if (synthetic_triangles > 0) snprintf(result.name, sizeof(result.name), "synthetic_%zu", synthetic_triangles);
+    else snprintf(result.name, sizeof(result.name), "assets");
+
+    Scene scene = create_bench_scene(config);
+    double start = omp_get_wtime();
+    setup_bench_scene(&scene, config, synthetic_triangles);
+    result.load_ms = (omp_get_wtime() - start) * 1000.0;
+
+    for (size_t m = 0; m < scene.mesh_count; m++) {
+        if (config->bvh_builder != BVH_BUILDER_MEAN_SPLIT) {
+            set_mesh_bvh_builder(&scene.meshes[m], config->bvh_builder);
+        }
+        set_mesh_accel(&scene.meshes[m], get_bench_accel(config, m));
+        result.accel_kb += get_accel_stats(&scene.meshes[m].accel).memory_bytes / 1024.0;
+        result.triangle_count += scene.meshes[m].triangle_count;
+    }
+
+    bench_bvh_build(&scene, config, &result);
+    bench_rays(&scene, config, &result);
+    bench_frames(&scene, synthetic_triangles > 0, &result);
+    bench_output(&scene, &result);
+
+    destroy_bench_scene(&scene);
+    return result;
+}
+
+// Render every frame in one batch through the frame-parallel path and keep a copy of the pixels
+static uint8_t* render_batched_frames(const BenchConfig* config, size_t synthetic_triangles, BVHBuilder builder,
+                                      size_t* size) {
+    Scene scene = create_bench_scene(config);
+    setup_bench_scene(&scene, config, synthetic_triangles);
+    for (size_t m = 0; m < scene.mesh_count; m++) {
+        if (builder != BVH_BUILDER_MEAN_SPLIT) set_mesh_bvh_builder(&scene.meshes[m], builder);
+    }
+
+    FrameState* states = (FrameState*)calloc(scene.frame_count, sizeof(FrameState));
+    for (int frame = 0; frame < scene.frame_count; frame++) {
+        if (synthetic_triangles > 0) animate_synthetic_scene(&scene, frame);
+        else animate_demo_scene(&scene, frame);
+        capture_frame_state(&scene, frame, &states[frame]);
+    }
+    render_scene_frames(&scene, states, scene.frame_count);
+
+    size_t frame_size = (size_t)scene.width * scene.height * 3;
+    uint8_t* pixels = (uint8_t*)malloc(frame_size * scene.frame_count);
+    for (int frame = 0; frame < scene.frame_count; frame++) {
+        memcpy(pixels + frame * frame_size, scene.frames[frame], frame_size);
+        destroy_frame_state(&states[frame]);
+    }
+    free(states);
+    *size = frame_size * scene.frame_count;
+    destroy_bench_scene(&scene);
+    return pixels;
+}
+
+// Lazy subtrees split during batched rendering must yield the same frames as the eager tree
+static bool check_lazy_batches(const BenchConfig* config, size_t synthetic_triangles) {
+    size_t size;
+    uint8_t* eager = render_batched_frames(config, synthetic_triangles, BVH_BUILDER_MEAN_SPLIT, &size);
+    uint8_t* lazy = render_batched_frames(config, synthetic_triangles, BVH_BUILDER_LAZY, &size);
+    bool same = memcmp(eager, lazy, size) == 0;
+    free(eager);
+    free(lazy);
+
+    if (synthetic_triangles > 0) printf("synthetic_%-10zu", synthetic_triangles);
+    else printf("%-20s", "assets");
+    printf(" lazy batched frames %s the eager tree\n", same ? "match" : "DIFFER from");
+    return same;
+}
+
+static void write_json(FILE* fp, const BenchConfig* config, const BenchResult* results, int count) {
+    fprintf(fp, "{\n  \"config\": {\"width\": %d, \"height\": %d, \"frames\": %d, \"repeats\": %d, "
+                "\"seed\": %u, \"threads\": %d, \"incremental\": %s, \"occluder_map\": %s, "
+                "\"bvh_builder\": \"%s\", \"accel\": [",
+            config->width, config->height, config->frames, config->repeats, config->seed,
+            omp_get_max_threads(), config->incremental ? "true" : "false",
+            config->occluder_map ? "true" : "false",
+            config->bvh_builder == BVH_BUILDER_MORTON ? "morton" :
+            config->bvh_builder == BVH_BUILDER_LAZY ? "lazy" : "mean");
+    for (int i = 0; i < config->accel_count; i++) {
+        fprintf(fp, "%s\"%s\"", i > 0 ? ", " : "", get_accel_type_name(config->accels[i]));
+    }
+    fprintf(fp, "], \"lights\": %d},\n", config->light_count);
+    fprintf(fp, "  \"results\": [\n");
+    for (int i = 0; i < count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"triangles\": %zu, \"load_ms\": %.3f, \"bvh_build_ms\": %.3f, "
+                    "\"accel_kb\": %.1f, \"primary_rays_per_sec\": %.0f, \"shadow_rays_per_sec\": %.0f, "
+                    "\"frame_ms_avg\": %.3f, \"frame_ms_min\": %.3f, \"frame_ms_max\": %.3f, "
+                    "\"upscale_ms\": %.3f, \"encode_ms\": %.3f}%s\n",
+                r->name, r->triangle_count, r->load_ms, r->bvh_build_ms, r->accel_kb,
+                r->primary_rays_per_sec, r->shadow_rays_per_sec,
+                r->frame_ms_avg, r->frame_ms_min, r->frame_ms_max,
+                r->upscale_ms, r->encode_ms, i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+static void write_csv(FILE* fp, const BenchResult* results, int count) {
+    fprintf(fp, "name,triangles,load_ms,bvh_build_ms,accel_kb,primary_rays_per_sec,shadow_rays_per_sec,"
+                "frame_ms_avg,frame_ms_min,frame_ms_max,upscale_ms,encode_ms\n");
+    for (int i = 0; i < count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(fp, "%s,%zu,%.3f,%.3f,%.1f,%.0f,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                r->name, r->triangle_count, r->load_ms, r->bvh_build_ms, r->accel_kb,
+                r->primary_rays_per_sec, r->shadow_rays_per_sec,
+                r->frame_ms_avg, r->frame_ms_min, r->frame_ms_max,
+                r->upscale_ms, r->encode_ms);
+    }
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --width N           render width (default 320)\n"
+        "  --height N          render height (default 240)\n"
+        "  --frames N          frames rendered per scene (default 8)\n"
+        "  --repeats N         repetitions of build and ray timings, best is kept (default 3)\n"
+        "  --seed N            seed for synthetic scenes (default 1)\n"
+        "  --triangles N       add a synthetic scene with N triangles, repeatable\n"
+        "  --no-assets         skip the bundled demo assets\n"
+        "  --no-incremental    re-trace every tile of every frame\n"
+        "  --no-occluder-map   test shadow rays against all meshes\n"
+        "  --builder NAME      BVH construction strategy: mean, morton or lazy (default mean)\n"
+        "  --accel LIST        acceleration structure per mesh, bvh, grid or paged, comma separated;\n"
+        "                      the last one covers the remaining meshes (default bvh)\n"
+        "  --lights N          add N random point lights to every scene\n"
+        "  --check-lazy        render batched frames with the lazy and the eager builder, exit 1 if they differ\n"
+        "  --format json|csv   output format (default json)\n"
+        "  --output FILE       output file (default bench_results.json or .csv)\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {320, 240, 8, 3, 1u, true, true, BVH_BUILDER_MEAN_SPLIT, {ACCEL_BVH}, 1, 0};
+    size_t synthetic[MAX_SYNTHETIC_SCENES];
+    int synthetic_count = 0;
+    bool assets = true;
+    bool csv = false;
+    bool check_lazy = false;
+    const char* output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--width") == 0 && has_value) config.width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--height") == 0 && has_value) config.height = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && has_value) config.frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && has_value) config.repeats = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) config.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--triangles") == 0 && has_value && synthetic_count < MAX_SYNTHETIC_SCENES) {
+            synthetic[synthetic_count++] = (size_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--no-assets") == 0) assets = false;
+        else if (strcmp(argv[i], "--no-incremental") == 0) config.incremental = false;
+        else if (strcmp(argv[i], "--no-occluder-map") == 0) config.occluder_map = false;
+        else if (strcmp(argv[i], "--builder") == 0 && has_value) {
+            const char* builder = argv[++i];
+            if (strcmp(builder, "morton") == 0) config.bvh_builder = BVH_BUILDER_MORTON;
+            else if (strcmp(builder, "lazy") == 0) config.bvh_builder = BVH_BUILDER_LAZY;
+            else if (strcmp(builder, "mean") == 0) config.bvh_builder = BVH_BUILDER_MEAN_SPLIT;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--accel") == 0 && has_value) {
+            char list[256];
+            snprintf(list, sizeof(list), "%s", argv[++i]);
+            config.accel_count = 0;
+            for (char* name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+                if (config.accel_count == MAX_BENCH_ACCELS || !parse_accel_type(name, &config.accels[config.accel_count])) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                config.accel_count++;
+            }
+            if (config.accel_count == 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--lights") == 0 && has_value) config.light_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--check-lazy") == 0) check_lazy = true;
+        else if (strcmp(argv[i], "--format") == 0 && has_value) csv = strcmp(argv[++i], "csv") == 0;
+        else if (strcmp(argv[i], "--output") == 0 && has_value) output = argv[++i];
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.width < 2 || config.height < 2 || config.frames < 1 || config.repeats < 1 || config.light_count < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (synthetic_count == 0) {
+        synthetic[synthetic_count++] = 10000;
+        synthetic[synthetic_count++] = 100000;
+    }
+
+    if (check_lazy) {
+        bool same = !assets || check_lazy_batches(&config, 0);
+        for (int i = 0; i < synthetic_count; i++) {
+            if (synthetic[i] > 0) same = check_lazy_batches(&config, synthetic[i]) && same;
+        }
+        return same ? 0 : 1;
+    }
+
+    BenchResult results[MAX_SYNTHETIC_SCENES + 1];
+    int count = 0;
+    if (assets) results[count++] = run_case(&config, 0);
+    for (int i = 0; i < synthetic_count; i++) {
+        if (synthetic[i] > 0) results[count++] = run_case(&config, synthetic[i]);
+    }
+
+    if (!output) output = csv ? "bench_results.csv" : "bench_results.json";
+    FILE* fp = fopen(output, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", output);
+        return 1;
+    }
+    if (csv) write_csv(fp, results, count);
+    else write_json(fp, &config, results, count);
+    fclose(fp);
+
+    // Short human readable summary
+    for (int i = 0; i < count; i++) {
+        printf("%-20s %9zu tris | build %8.2f ms %9.1f KB | primary %6.2f Mrays/s | shadow %6.2f Mrays/s | frame %8.2f ms\n",
+               results[i].name, results[i].triangle_count, results[i].bvh_build_ms, results[i].accel_kb,
+               results[i].primary_rays_per_sec / 1e6, results[i].shadow_rays_per_sec / 1e6,
+               results[i].frame_ms_avg);
+    }
+    printf("Results written to %s\n", output);
+    return 0;
+}
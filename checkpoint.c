@@ -0,0 +1,136 @@
+#include "checkpoint.h"
+#include "utils/hash.h"
+#include <string.h>
+#include <unistd.h>
+
+#define MANIFEST_HEADER "raytracer-checkpoint 1 frames=%d output=%dx%d duration=%d\n"
+
+static uint64_t hash_frame(const Scene* scene, int frame) {
+    size_t size = (size_t)scene->frame_widths[frame] * scene->frame_heights[frame] * 3;
+    return hash_bytes(scene->frames[frame], size, HASH_SEED);
+}
+
+// Load frames listed in an existing manifest, keeping only those whose checksum matches
+static bool resume_checkpoint(Checkpoint* checkpoint, Scene* scene, const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) return true;
+
+    char line[256], expected[256];
+    snprintf(expected, sizeof(expected), MANIFEST_HEADER,
+             scene->frame_count, scene->output_width, scene->output_height, scene->duration_ms);
+    if (!fgets(line, sizeof(line), fp) || strcmp(line, expected) != 0) {
+        fprintf(stderr, "Checkpoint in %s was made for different scene settings\n", checkpoint->directory);
+        fclose(fp);
+        return false;
+    }
+
+    int restored = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        int frame, width, height;
+        unsigned long long checksum;
+        if (sscanf(line, "%d %d %d %llx", &frame, &width, &height, &checksum) != 4) continue;
+        if (frame < 0 || frame >= scene->frame_count) continue;
+        if (!load_scene_frame(scene, frame, checkpoint->directory)) continue;
+
+        if (scene->frame_widths[frame] != width || scene->frame_heights[frame] != height ||
+            hash_frame(scene, frame) != checksum) {
+            fprintf(stderr, "Checksum mismatch for frame %d, rendering it again\n", frame);
+            continue;
+        }
+        if (!checkpoint->completed[frame]) restored++;
+        checkpoint->completed[frame] = true;
+    }
+    fclose(fp);
+
+    printf("Resumed %d of %d frames from %s\n", restored, scene->frame_count, checkpoint->directory);
+    return true;
+}
+
+bool open_checkpoint(Checkpoint* checkpoint, Scene* scene, const char* directory, int interval, bool resume) {
+    memset(checkpoint, 0, sizeof(Checkpoint));
+    snprintf(checkpoint->directory, sizeof(checkpoint->directory), "%s", directory);
+    checkpoint->interval = interval > 0 ? interval : 1;
+    checkpoint->frame_count = scene->frame_count;
+    checkpoint->completed = (bool*)calloc(scene->frame_count, sizeof(bool));
+    checkpoint->pending = (int*)malloc(scene->frame_count * sizeof(int));
+
+    if (!create_frame_directory(directory)) return false;
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s/manifest.txt", directory);
+    if (resume && !resume_checkpoint(checkpoint, scene, filename)) return false;
+
+    // Rewrite the manifest with only the verified frames, replacing the old one atomically
+    char temp_filename[1100];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    FILE* fp = fopen(temp_filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", temp_filename);
+        return false;
+    }
+    fprintf(fp, MANIFEST_HEADER,
+            scene->frame_count, scene->output_width, scene->output_height, scene->duration_ms);
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        if (!checkpoint->completed[frame]) continue;
+        fprintf(fp, "%d %d %d %016llx\n", frame,
+                scene->frame_widths[frame], scene->frame_heights[frame],
+                (unsigned long long)hash_frame(scene, frame));
+    }
+    fflush(fp);
+    fsync(fileno(fp));
+    fclose(fp);
+    if (rename(temp_filename, filename) != 0) {
+        fprintf(stderr, "Failed to write %s\n", filename);
+        return false;
+    }
+
+    // New frames are appended as they are checkpointed
+    checkpoint->manifest = fopen(filename, "a");
+    if (!checkpoint->manifest) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return false;
+    }
+    return true;
+}
+
+bool is_frame_checkpointed(const Checkpoint* checkpoint, int frame) {
+    return checkpoint->completed && frame >= 0 && frame < checkpoint->frame_count &&
+           checkpoint->completed[frame];
+}
+
+bool checkpoint_frame(Checkpoint* checkpoint, const Scene* scene, int frame) {
+    checkpoint->pending[checkpoint->pending_count++] = frame;
+    if (checkpoint->pending_count < checkpoint->interval) return true;
+    return flush_checkpoint(checkpoint, scene);
+}
+
+bool flush_checkpoint(Checkpoint* checkpoint, const Scene* scene) {
+    if (!checkpoint->manifest) return false;
+
+    // Frame files go first, the manifest only lists frames that are fully written
+    for (int i = 0; i < checkpoint->pending_count; i++) {
+        int frame = checkpoint->pending[i];
+        if (!save_scene_frame(scene, frame, checkpoint->directory)) return false;
+        fprintf(checkpoint->manifest, "%d %d %d %016llx\n", frame,
+                scene->frame_widths[frame], scene->frame_heights[frame],
+                (unsigned long long)hash_frame(scene, frame));
+        checkpoint->completed[frame] = true;
+    }
+    checkpoint->pending_count = 0;
+
+    fflush(checkpoint->manifest);
+    fsync(fileno(checkpoint->manifest));
+    return true;
+}
+
+void close_checkpoint(Checkpoint* checkpoint, const Scene* scene) {
+    if (checkpoint->manifest) {
+        flush_checkpoint(checkpoint, scene);
+        fclose(checkpoint->manifest);
+    }
+    free(checkpoint->completed);
+    free(checkpoint->pending);
+    checkpoint->manifest = NULL;
+    checkpoint->completed = NULL;
+    checkpoint->pending = NULL;
+}
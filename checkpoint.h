@@ -0,0 +1,23 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "scene.h"
+
+typedef struct {
+    char directory[1024];
+    FILE* manifest;             // One line per frame safely on disk
+    bool* completed;
+    int* pending;               // Finished frames not written yet
+    int pending_count;
+    int interval;               // Frames per checkpoint write
+    int frame_count;
+} Checkpoint;
+
+// Checkpoint operations
+bool open_checkpoint(Checkpoint* checkpoint, Scene* scene, const char* directory, int interval, bool resume);
+bool is_frame_checkpointed(const Checkpoint* checkpoint, int frame);
+bool checkpoint_frame(Checkpoint* checkpoint, const Scene* scene, int frame);
+bool flush_checkpoint(Checkpoint* checkpoint, const Scene* scene);
+void close_checkpoint(Checkpoint* checkpoint, const Scene* scene);
+
+#endif
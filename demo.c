@@ -0,0 +1,48 @@
+#include "demo.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void setup_demo_scene(Scene* scene) {
+    // Set up camera
+    set_scene_camera(scene,
+        (Vec3){-3.0f, 3.0f, -3.0f},
+        (Vec3){0.0f, 0.0f, 0.0f},
+        (Vec3){0.0f, 1.0f, 0.0f},
+        60.0f
+    );
+    
+    // Set up light
+    set_scene_light(scene,
+        (Vec3){1.0f, 1.0f, -1.0f},     // Direction
+        (Vec3){1.4f, 1.4f, 1.4f}       // White light
+    );
+    
+    // Add meshes to scene
+    Mesh drone = create_mesh("assets/drone.obj", "assets/drone.webp");
+    add_mesh_to_scene(scene, drone);
+    
+    Mesh treasure = create_mesh("assets/treasure.obj", "assets/treasure.webp");
+    add_mesh_to_scene(scene, treasure);
+    
+    Mesh ground = create_mesh("assets/ground.obj", "assets/ground.webp");
+    add_mesh_to_scene(scene, ground);
+}
+
+void animate_demo_scene(Scene* scene, int frame) {
+    float t = frame * (2.0f * M_PI / 120.0f);
+    
+    // Animate drone
+    set_mesh_position(&scene->meshes[0], 
+        (Vec3){2.0f * cosf(t), 1.0f + 0.2f * sinf(2*t), 2.0f * sinf(t)});
+    set_mesh_rotation(&scene->meshes[0], 
+        (Vec3){0.1f * sinf(t), t, 0.1f * cosf(t)});
+    
+    // Animate treasure
+    set_mesh_position(&scene->meshes[1], 
+        (Vec3){1.0f, 0.5f + 0.1f * sinf(t), 1.0f});
+    set_mesh_rotation(&scene->meshes[1], 
+        (Vec3){0, t * 0.5f, 0});
+}
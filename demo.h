@@ -0,0 +1,10 @@
+#ifndef DEMO_H
+#define DEMO_H
+
+#include "scene.h"
+
+// Demo scene: a drone circling a floating treasure chest above the ground
+void setup_demo_scene(Scene* scene);
+void animate_demo_scene(Scene* scene, int frame);
+
+#endif
@@ -0,0 +1,104 @@
+#include "frame_cache.h"
+#include "utils/hash.h"
+
+static void get_cache_filename(char* buffer, size_t size, const FrameCache* cache, uint64_t key) {
+    snprintf(buffer, size, "%s/%016llx.rgb", cache->directory, (unsigned long long)key);
+}
+
+bool open_frame_cache(FrameCache* cache, const Scene* scene, const char* directory) {
+    memset(cache, 0, sizeof(FrameCache));
+    snprintf(cache->directory, sizeof(cache->directory), "%s", directory);
+    if (!create_frame_directory(directory)) return false;
+
+    // Assets are fixed for the whole run, hash their contents once
+    uint64_t hash = HASH_SEED;
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        const Mesh* mesh = &scene->meshes[m];
+        if (mesh->triangles) {
+            hash = hash_bytes(mesh->triangles, mesh->triangle_count * sizeof(Triangle), hash);
+        } else {
+            hash = hash_bytes(&mesh->accel.paged->header.content_hash, sizeof(uint64_t), hash);
+        }
+        hash = hash_bytes(&mesh->texture_width, sizeof(int), hash);
+        hash = hash_bytes(&mesh->texture_height, sizeof(int), hash);
+        if (mesh->texture_data) {
+            hash = hash_bytes(mesh->texture_data, (size_t)mesh->texture_width * mesh->texture_height * 4, hash);
+        }
+        hash = hash_bytes(&mesh->bvh_builder, sizeof(BVHBuilder), hash);
+        hash = hash_bytes(&mesh->accel.type, sizeof(AccelType), hash);
+    }
+    cache->asset_hash = hash;
+    return true;
+}
+
+// Everything the pixels depend on. The hashed structs hold only 4-byte fields, so they have no padding.
+uint64_t hash_frame_inputs(const FrameCache* cache, const Scene* scene) {
+    int settings[] = {
+        FRAME_CACHE_VERSION, scene->output_width, scene->output_height,
+        scene->dynamic_resolution, scene->use_visibility_buffer, (int)scene->mesh_count
+    };
+    uint64_t hash = hash_bytes(&cache->asset_hash, sizeof(uint64_t), HASH_SEED);
+    hash = hash_bytes(settings, sizeof(settings), hash);
+    hash = hash_bytes(&scene->scale_factor, sizeof(float), hash);
+    // Scale the controller renders the next frame at, it only changes after a frame is rendered
+    hash = hash_bytes(&scene->resolution.scale, sizeof(float), hash);
+    hash = hash_bytes(&scene->camera, sizeof(Camera), hash);
+    hash = hash_bytes(&scene->light, sizeof(DirectionalLight), hash);
+    hash = hash_bytes(scene->lights, scene->light_count * sizeof(Light), hash);
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        hash = hash_bytes(&scene->meshes[m].transform, sizeof(Transform), hash);
+    }
+    return hash;
+}
+
+bool load_cached_frame(FrameCache* cache, Scene* scene, int frame, uint64_t key) {
+    char filename[1100];
+    get_cache_filename(filename, sizeof(filename), cache, key);
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        cache->misses++;
+        return false;
+    }
+    fclose(fp);
+
+    FrameHeader header;
+    if (!read_frame_file(filename, &header, scene->frames[frame], scene->frame_capacity) ||
+        header.output_width != scene->output_width || header.output_height != scene->output_height) {
+        cache->misses++;
+        return false;
+    }
+    scene->frame_widths[frame] = header.width;
+    scene->frame_heights[frame] = header.height;
+
+    // Incremental rendering copies clean tiles from the last rendered frame, which this may overwrite
+    if (frame == scene->dirty.last_frame) invalidate_dirty_tracker(&scene->dirty);
+    cache->hits++;
+    return true;
+}
+
+bool store_cached_frame(FrameCache* cache, const Scene* scene, int frame, uint64_t key) {
+    FrameHeader header = {
+        .magic = FRAME_FILE_MAGIC,
+        .version = FRAME_FILE_VERSION,
+        .frame = frame,
+        .frame_count = scene->frame_count,
+        .width = scene->frame_widths[frame],
+        .height = scene->frame_heights[frame],
+        .output_width = scene->output_width,
+        .output_height = scene->output_height,
+        .duration_ms = scene->duration_ms
+    };
+    char filename[1100];
+    get_cache_filename(filename, sizeof(filename), cache, key);
+    return write_frame_file(filename, &header, scene->frames[frame]);
+}
+
+void copy_cached_frame(FrameCache* cache, Scene* scene, int frame, int source_frame) {
+    size_t size = (size_t)scene->frame_widths[source_frame] * scene->frame_heights[source_frame] * 3;
+    memcpy(scene->frames[frame], scene->frames[source_frame], size);
+    scene->frame_widths[frame] = scene->frame_widths[source_frame];
+    scene->frame_heights[frame] = scene->frame_heights[source_frame];
+
+    if (frame == scene->dirty.last_frame) invalidate_dirty_tracker(&scene->dirty);
+    cache->hits++;
+}
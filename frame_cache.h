@@ -0,0 +1,23 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include "scene.h"
+
+#define FRAME_CACHE_VERSION 2   // Bump when shading changes, old entries stop matching
+
+typedef struct {
+    char directory[1024];
+    uint64_t asset_hash;        // Mesh geometry, textures and BVH builders
+    int hits;
+    int misses;
+} FrameCache;
+
+// Frame cache operations, open after all meshes were added
+bool open_frame_cache(FrameCache* cache, const Scene* scene, const char* directory);
+uint64_t hash_frame_inputs(const FrameCache* cache, const Scene* scene);
+bool load_cached_frame(FrameCache* cache, Scene* scene, int frame, uint64_t key);
+bool store_cached_frame(FrameCache* cache, const Scene* scene, int frame, uint64_t key);
+// Reuse a frame rendered earlier in the same batch with an identical key, counted as a hit
+void copy_cached_frame(FrameCache* cache, Scene* scene, int frame, int source_frame);
+
+#endif
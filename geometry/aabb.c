@@ -22,6 +22,24 @@ AABB expand_aabb(AABB box, Vec3 point) {
     };
 }
 
+AABB merge_aabb(AABB a, AABB b) {
+    return expand_aabb(expand_aabb(a, b.min), b.max);
+}
+
+AABB transform_aabb(AABB box, const Affine3x4* m) {
+    // Bound all 8 transformed corners
+    AABB result = create_empty_aabb();
+    for (int i = 0; i < 8; i++) {
+        Vec3 corner = {
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z
+        };
+        result = expand_aabb(result, affine_transform_point(m, corner));
+    }
+    return result;
+}
+
 AABB get_triangle_bounds(Triangle tri) {
     AABB bounds = create_empty_aabb();
     bounds = expand_aabb(bounds, tri.v0);
@@ -31,26 +49,6 @@ AABB get_triangle_bounds(Triangle tri) {
 }
 
 bool ray_aabb_intersect(Ray ray, AABB box) {
-    Vec3 inv_dir = (Vec3){
-        1.0f / ray.direction.x,
-        1.0f / ray.direction.y,
-        1.0f / ray.direction.z
-    };
-
-    float tx1 = (box.min.x - ray.origin.x) * inv_dir.x;
-    float tx2 = (box.max.x - ray.origin.x) * inv_dir.x;
-    float tmin = fminf(tx1, tx2);
-    float tmax = fmaxf(tx1, tx2);
-
-    float ty1 = (box.min.y - ray.origin.y) * inv_dir.y;
-    float ty2 = (box.max.y - ray.origin.y) * inv_dir.y;
-    tmin = fmaxf(tmin, fminf(ty1, ty2));
-    tmax = fminf(tmax, fmaxf(ty1, ty2));
-
-    float tz1 = (box.min.z - ray.origin.z) * inv_dir.z;
-    float tz2 = (box.max.z - ray.origin.z) * inv_dir.z;
-    tmin = fmaxf(tmin, fminf(tz1, tz2));
-    tmax = fminf(tmax, fmaxf(tz1, tz2));
-
-    return tmax >= tmin && tmax > 0;
-}
\ No newline at end of file
+    SlabRay slab = create_slab_ray(ray);
+    return slab_ray_intersect(&slab, &box);
+}
@@ -11,10 +11,61 @@ typedef struct {
     Vec3 max;
 } AABB;
 
+// Ray origin and reciprocal direction in SSE registers, prepared once per traversal
+typedef struct {
+    Vec3A origin;
+    Vec3A inv_direction;
+} SlabRay;
+
 // AABB operations
 AABB create_empty_aabb(void);
 AABB expand_aabb(AABB box, Vec3 point);
+AABB merge_aabb(AABB a, AABB b);
+AABB transform_aabb(AABB box, const Affine3x4* m);
 AABB get_triangle_bounds(Triangle tri);
 bool ray_aabb_intersect(Ray ray, AABB box);
 
+static inline SlabRay create_slab_ray(Ray ray) {
+    Vec3 inv_direction = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    return (SlabRay){vec3a_from_vec3(ray.origin), vec3a_from_vec3(inv_direction)};
+}
+
+// All three slabs in one pass, only the x, y and z lanes take part in the reduction
+static inline bool slab_ray_intersect(const SlabRay* ray, const AABB* box) {
+#ifdef __SSE__
+    // The six bounds are contiguous, so two unaligned loads cover min and max without reading past the box
+    __m128 box_min = _mm_loadu_ps(&box->min.x);
+    __m128 box_max = _mm_loadu_ps(&box->min.z);
+    box_max = _mm_shuffle_ps(box_max, box_max, _MM_SHUFFLE(3, 3, 2, 1));
+
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(box_min, ray->origin.m), ray->inv_direction.m);
+    __m128 t2 = _mm_mul_ps(_mm_sub_ps(box_max, ray->origin.m), ray->inv_direction.m);
+    __m128 t_near = _mm_min_ps(t1, t2);
+    __m128 t_far = _mm_max_ps(t1, t2);
+
+    t_near = _mm_max_ss(t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(1, 1, 1, 1)));
+    t_near = _mm_max_ss(t_near, _mm_movehl_ps(t_near, t_near));
+    t_far = _mm_min_ss(t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(1, 1, 1, 1)));
+    t_far = _mm_min_ss(t_far, _mm_movehl_ps(t_far, t_far));
+    float tmin = _mm_cvtss_f32(t_near);
+    float tmax = _mm_cvtss_f32(t_far);
+#else
+    float tx1 = (box->min.x - ray->origin.x) * ray->inv_direction.x;
+    float tx2 = (box->max.x - ray->origin.x) * ray->inv_direction.x;
+    float tmin = fminf(tx1, tx2);
+    float tmax = fmaxf(tx1, tx2);
+
+    float ty1 = (box->min.y - ray->origin.y) * ray->inv_direction.y;
+    float ty2 = (box->max.y - ray->origin.y) * ray->inv_direction.y;
+    tmin = fmaxf(tmin, fminf(ty1, ty2));
+    tmax = fminf(tmax, fmaxf(ty1, ty2));
+
+    float tz1 = (box->min.z - ray->origin.z) * ray->inv_direction.z;
+    float tz2 = (box->max.z - ray->origin.z) * ray->inv_direction.z;
+    tmin = fmaxf(tmin, fminf(tz1, tz2));
+    tmax = fminf(tmax, fmaxf(tz1, tz2));
+#endif
+    return tmax >= tmin && tmax > 0;
+}
+
 #endif
\ No newline at end of file
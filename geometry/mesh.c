@@ -3,6 +3,38 @@
 #include <webp/encode.h>
 #include <math.h>
 
+static void cache_mesh_transform(Mesh* mesh) {
+    mesh->object_to_world = transform_to_affine(mesh->transform);
+    mesh->world_to_object = affine_rigid_inverse(&mesh->object_to_world);
+    mesh->cached_transform = mesh->transform;
+}
+
+static bool load_mesh_texture(Mesh* mesh, const char* texture_filename) {
+    FILE* tex_file = fopen(texture_filename, "rb");
+    if (!tex_file) {
+        fprintf(stderr, "Failed to open texture %s\n", texture_filename);
+        return false;
+    }
+
+    fseek(tex_file, 0, SEEK_END);
+    size_t file_size = ftell(tex_file);
+    fseek(tex_file, 0, SEEK_SET);
+
+    uint8_t* file_data = (uint8_t*)malloc(file_size);
+    if (fread(file_data, 1, file_size, tex_file) != file_size) {
+        free(file_data);
+        fclose(tex_file);
+        return false;
+    }
+    fclose(tex_file);
+
+    mesh->texture_data = WebPDecodeRGBA(file_data, file_size, 
+                                       &mesh->texture_width, 
+                                       &mesh->texture_height);
+    free(file_data);
+    return true;
+}
+
 Mesh create_mesh(const char* obj_filename, const char* texture_filename) {
     Mesh mesh = {
         .triangles = NULL,
@@ -10,34 +42,42 @@ Mesh create_mesh(const char* obj_filename, const char* texture_filename) {
         .texture_data = NULL,
         .texture_width = 0,
         .texture_height = 0,
-        .bvh = {
-            .root = NULL,
-            .triangles = NULL,
-            .triangle_count = 0
+        .accel = {
+            .backend = NULL
         },
         .transform = {
             .position = {0, 0, 0},
             .rotation = {0, 0, 0}
         }
     };
+    cache_mesh_transform(&mesh);
     
-    // Load geometry
-    Vec3* vertices = (Vec3*)malloc(1000000 * sizeof(Vec3));
-    Vec2* texcoords = (Vec2*)malloc(1000000 * sizeof(Vec2));
-    Vec3* normals = (Vec3*)malloc(1000000 * sizeof(Vec3));
-    int vertex_count = 0, texcoord_count = 0, normal_count = 0, triangle_count = 0;
-    mesh.triangles = (Triangle*)malloc(1000000 * sizeof(Triangle));
-
     FILE* file = fopen(obj_filename, "r");
     if (!file) { 
         fprintf(stderr, "Failed to open %s\n", obj_filename); 
-        free(vertices);
-        free(texcoords);
-        free(normals);
         return mesh;
     }
 
+    // First pass counts elements so every array is allocated exactly once
+    int vertex_count = 0, texcoord_count = 0, normal_count = 0, triangle_count = 0;
     char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v' && line[1] == ' ') vertex_count++;
+        else if (line[0] == 'v' && line[1] == 't') texcoord_count++;
+        else if (line[0] == 'v' && line[1] == 'n') normal_count++;
+        else if (line[0] == 'f') triangle_count++;
+    }
+    rewind(file);
+
+    // Load geometry, temporaries live in a scratch arena dropped after parsing
+    Arena scratch = create_arena(0);
+    Vec3* vertices = (Vec3*)arena_alloc(&scratch, vertex_count * sizeof(Vec3), _Alignof(Vec3));
+    Vec2* texcoords = (Vec2*)arena_alloc(&scratch, texcoord_count * sizeof(Vec2), _Alignof(Vec2));
+    Vec3* normals = (Vec3*)arena_alloc(&scratch, normal_count * sizeof(Vec3), _Alignof(Vec3));
+    mesh.arena = create_arena(triangle_count * sizeof(Triangle));
+    mesh.triangles = (Triangle*)arena_alloc(&mesh.arena, triangle_count * sizeof(Triangle), ARENA_ALIGNMENT);
+    vertex_count = texcoord_count = normal_count = triangle_count = 0;
+
     while (fgets(line, sizeof(line), file)) {
         if (line[0] == 'v' && line[1] == ' ') {
             sscanf(line + 2, "%f %f %f", 
@@ -76,60 +116,169 @@ Mesh create_mesh(const char* obj_filename, const char* texture_filename) {
     }
     mesh.triangle_count = triangle_count;
     fclose(file);
+    destroy_arena(&scratch);
 
     // Load texture
-    FILE* tex_file = fopen(texture_filename, "rb");
-    if (!tex_file) {
-        fprintf(stderr, "Failed to open texture %s\n", texture_filename);
-        free(vertices);
-        free(texcoords);
-        free(normals);
+    if (!load_mesh_texture(&mesh, texture_filename)) return mesh;
+
+    mesh.accel = create_accel(ACCEL_BVH, mesh.triangles, triangle_count, BVH_BUILDER_MEAN_SPLIT);
+
+    printf("Loaded %d vertices, %d texcoords, %d normals, %d triangles\n", 
+           vertex_count, texcoord_count, normal_count, triangle_count);
+
+    return mesh;
+}
+
+// Out-of-core mesh, triangles are read from the paged geometry file only when rays reach them
+Mesh open_paged_mesh(const char* geometry_filename, const char* texture_filename, size_t budget_bytes) {
+    Mesh mesh = {
+        .accel = {
+            .backend = NULL
+        },
+        .transform = {
+            .position = {0, 0, 0},
+            .rotation = {0, 0, 0}
+        }
+    };
+    cache_mesh_transform(&mesh);
+
+    PagedGeometry* geometry = open_paged_geometry(geometry_filename, budget_bytes);
+    if (!geometry) return mesh;
+    if (!load_mesh_texture(&mesh, texture_filename)) {
+        release_paged_geometry(geometry);
         return mesh;
     }
+    mesh.triangle_count = geometry->header.triangle_count;
+    mesh.accel = create_paged_accel(geometry);
 
-    fseek(tex_file, 0, SEEK_END);
-    size_t file_size = ftell(tex_file);
-    fseek(tex_file, 0, SEEK_SET);
+    printf("Paged %zu triangles in %u pages of up to %llu bytes\n", mesh.triangle_count,
+           geometry->header.page_count, (unsigned long long)geometry->header.page_bytes);
+    return mesh;
+}
 
-    uint8_t* file_data = (uint8_t*)malloc(file_size);
-    if (fread(file_data, 1, file_size, tex_file) != file_size) {
-        free(file_data);
-        fclose(tex_file);
-        free(vertices);
-        free(texcoords);
-        free(normals);
-        return mesh;
+// Write the BVH and triangles to a paged geometry file, then trace through it and free the resident triangles
+bool page_out_mesh(Mesh* mesh, const char* filename, size_t budget_bytes) {
+    if (!mesh->accel.backend || mesh->accel.type != ACCEL_BVH || !mesh->triangles) {
+        fprintf(stderr, "Only meshes with resident triangles and a BVH can be paged out\n");
+        return false;
     }
-    fclose(tex_file);
+    if (!write_paged_geometry(filename, &mesh->accel.bvh)) return false;
+    PagedGeometry* geometry = open_paged_geometry(filename, budget_bytes);
+    if (!geometry) return false;
 
-    mesh.texture_data = WebPDecodeRGBA(file_data, file_size, 
-                                      &mesh.texture_width, 
-                                      &mesh.texture_height);
-    free(file_data);
+    destroy_accel(&mesh->accel);
+    mesh->accel = create_paged_accel(geometry);
+    destroy_arena(&mesh->arena);
+    mesh->triangles = NULL;
+    return true;
+}
 
-    mesh.bvh = create_bvh(mesh.triangles, triangle_count);
+// Resident triangles are returned in place, paged ones are copied into scratch
+const Triangle* get_mesh_triangle(const Mesh* mesh, size_t index, Triangle* scratch) {
+    if (mesh->triangles) return &mesh->triangles[index];
+    get_paged_triangle(mesh->accel.paged, (int)index, scratch);
+    return scratch;
+}
 
-    printf("Loaded %d vertices, %d texcoords, %d normals, %d triangles\n", 
-           vertex_count, texcoord_count, normal_count, triangle_count);
+Mesh create_mesh_from_triangles(const Triangle* triangles, size_t count) {
+    Mesh mesh = {
+        .triangle_count = count,
+        .texture_data = (unsigned char*)WebPMalloc(4),
+        .texture_width = 1,
+        .texture_height = 1,
+        .transform = {
+            .position = {0, 0, 0},
+            .rotation = {0, 0, 0}
+        }
+    };
+    mesh.arena = create_arena(count * sizeof(Triangle));
+    mesh.triangles = (Triangle*)arena_alloc(&mesh.arena, count * sizeof(Triangle), ARENA_ALIGNMENT);
+    memcpy(mesh.triangles, triangles, count * sizeof(Triangle));
+
+    // Plain white texture
+    memset(mesh.texture_data, 255, 4);
 
-    free(vertices);
-    free(texcoords);
-    free(normals);
+    mesh.accel = create_accel(ACCEL_BVH, mesh.triangles, count, BVH_BUILDER_MEAN_SPLIT);
+    cache_mesh_transform(&mesh);
     return mesh;
 }
 
+// Deep copy of geometry, texture and acceleration structure. Pages land on the NUMA node of the copying thread.
+// Paged meshes share their geometry file and page cache with the copy.
+Mesh copy_mesh(const Mesh* mesh) {
+    Mesh copy = *mesh;
+    copy.arena = create_arena(mesh->triangles ? mesh->triangle_count * sizeof(Triangle) : 0);
+    if (mesh->triangles) {
+        copy.triangles = (Triangle*)arena_alloc(&copy.arena, mesh->triangle_count * sizeof(Triangle), ARENA_ALIGNMENT);
+        memcpy(copy.triangles, mesh->triangles, mesh->triangle_count * sizeof(Triangle));
+    }
+
+    if (mesh->texture_data) {
+        size_t texture_size = (size_t)mesh->texture_width * mesh->texture_height * 4;
+        copy.texture_data = (unsigned char*)WebPMalloc(texture_size);
+        memcpy(copy.texture_data, mesh->texture_data, texture_size);
+    }
+
+    copy.accel = copy_accel(&mesh->accel, copy.triangles);
+    return copy;
+}
+
 void set_mesh_position(Mesh* mesh, Vec3 position) {
     mesh->transform.position = position;
+    update_mesh_transform(mesh);
 }
 
 void set_mesh_rotation(Mesh* mesh, Vec3 rotation) {
     mesh->transform.rotation = rotation;
+    update_mesh_transform(mesh);
+}
+
+static bool is_transform_cached(const Mesh* mesh) {
+    return memcmp(&mesh->transform, &mesh->cached_transform, sizeof(Transform)) == 0;
+}
+
+// Rebuild the cached matrices if the transform was changed since the last update
+void update_mesh_transform(Mesh* mesh) {
+    if (!is_transform_cached(mesh)) cache_mesh_transform(mesh);
+}
+
+// Transforms written directly without an update are still honored, just computed on the spot
+Affine3x4 get_mesh_object_to_world(const Mesh* mesh) {
+    if (is_transform_cached(mesh)) return mesh->object_to_world;
+    return transform_to_affine(mesh->transform);
+}
+
+Affine3x4 get_mesh_world_to_object(const Mesh* mesh) {
+    if (is_transform_cached(mesh)) return mesh->world_to_object;
+    Affine3x4 model = transform_to_affine(mesh->transform);
+    return affine_rigid_inverse(&model);
+}
+
+void set_mesh_bvh_builder(Mesh* mesh, BVHBuilder builder) {
+    mesh->bvh_builder = builder;
+    rebuild_mesh_accel(mesh);
+}
+
+// Replace the acceleration structure, triangle indices from the old one become invalid
+void set_mesh_accel(Mesh* mesh, AccelType type) {
+    if (mesh->accel.backend && mesh->accel.type == type) return;
+    if (!mesh->triangles) {
+        fprintf(stderr, "Paged meshes keep their paged geometry\n");
+        return;
+    }
+    destroy_accel(&mesh->accel);
+    mesh->accel = create_accel(type, mesh->triangles, mesh->triangle_count, mesh->bvh_builder);
+}
+
+// Call after the triangles were modified, e.g. when deforming a mesh every frame
+void rebuild_mesh_accel(Mesh* mesh) {
+    rebuild_accel(&mesh->accel, mesh->bvh_builder);
 }
 
 void destroy_mesh(Mesh* mesh) {
-    if (mesh->triangles) free(mesh->triangles);
     if (mesh->texture_data) WebPFree(mesh->texture_data);
-    destroy_bvh(&mesh->bvh);
+    destroy_accel(&mesh->accel);
+    destroy_arena(&mesh->arena);
     mesh->triangles = NULL;
     mesh->texture_data = NULL;
     mesh->triangle_count = 0;
@@ -146,4 +295,10 @@ Vec3 sample_mesh_texture(const Mesh* mesh, float u, float v) {
         mesh->texture_data[idx + 1] / 255.0f,
         mesh->texture_data[idx + 2] / 255.0f
     };
+}
+
+AABB get_mesh_world_bounds(const Mesh* mesh, Transform transform) {
+    if (!mesh->accel.backend || mesh->triangle_count == 0) return create_empty_aabb();
+    Affine3x4 model = transform_to_affine(transform);
+    return transform_aabb(get_accel_bounds(&mesh->accel), &model);
 }
\ No newline at end of file
@@ -2,27 +2,45 @@
 #define MESH_H
 
 #include "triangle.h"
-#include "accel/bvh.h"
+#include "accel/accel.h"
 #include "math/ray.h"
+#include "utils/arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 typedef struct {
-    Triangle* triangles;
+    Triangle* triangles;        // NULL for paged meshes, see get_mesh_triangle
     size_t triangle_count;
     unsigned char* texture_data;
     int texture_width;
     int texture_height;
-    BVH bvh;
+    Accel accel;                // BVH unless set_mesh_accel picked another backend
+    BVHBuilder bvh_builder;     // Strategy used whenever the BVH is rebuilt
     Transform transform;
+    Transform cached_transform; // Transform the two matrices below were built from
+    Affine3x4 object_to_world;
+    Affine3x4 world_to_object;
+    Arena arena;                // Owns the triangle array
 } Mesh;
 
 // Mesh operations
 Mesh create_mesh(const char* obj_filename, const char* texture_filename);
+Mesh create_mesh_from_triangles(const Triangle* triangles, size_t count);
+Mesh open_paged_mesh(const char* geometry_filename, const char* texture_filename, size_t budget_bytes);
+bool page_out_mesh(Mesh* mesh, const char* filename, size_t budget_bytes);
+const Triangle* get_mesh_triangle(const Mesh* mesh, size_t index, Triangle* scratch);
+Mesh copy_mesh(const Mesh* mesh);
 void set_mesh_position(Mesh* mesh, Vec3 position);
 void set_mesh_rotation(Mesh* mesh, Vec3 rotation);
+void update_mesh_transform(Mesh* mesh);
+Affine3x4 get_mesh_object_to_world(const Mesh* mesh);
+Affine3x4 get_mesh_world_to_object(const Mesh* mesh);
+void set_mesh_bvh_builder(Mesh* mesh, BVHBuilder builder);
+void set_mesh_accel(Mesh* mesh, AccelType type);
+void rebuild_mesh_accel(Mesh* mesh);
 void destroy_mesh(Mesh* mesh);
 Vec3 sample_mesh_texture(const Mesh* mesh, float u, float v);
+AABB get_mesh_world_bounds(const Mesh* mesh, Transform transform);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include "vec3.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// Vec3 padded to one 16-byte SSE register, w is unused
+typedef union {
+#ifdef __SSE__
+    __m128 m;
+#endif
+    struct { float x, y, z, w; };
+} __attribute__((aligned(16))) Vec3A;
+
+// 3x4 affine matrix stored by columns: the images of the x, y and z axes, then the translation
+typedef struct {
+    Vec3A columns[4];
+} Affine3x4;
+
+static inline Vec3A vec3a_from_vec3(Vec3 v) {
+    Vec3A a;
+#ifdef __SSE__
+    a.m = _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+#else
+    a.x = v.x; a.y = v.y; a.z = v.z; a.w = 0.0f;
+#endif
+    return a;
+}
+
+static inline Vec3 vec3_from_vec3a(Vec3A a) {
+    return (Vec3){a.x, a.y, a.z};
+}
+
+static inline Affine3x4 create_affine(Vec3 x_axis, Vec3 y_axis, Vec3 z_axis, Vec3 translation) {
+    return (Affine3x4){{
+        vec3a_from_vec3(x_axis), vec3a_from_vec3(y_axis),
+        vec3a_from_vec3(z_axis), vec3a_from_vec3(translation)
+    }};
+}
+
+// Linear part only, for directions and normals
+static inline Vec3 affine_transform_vector(const Affine3x4* a, Vec3 v) {
+#ifdef __SSE__
+    __m128 r = _mm_mul_ps(a->columns[0].m, _mm_set1_ps(v.x));
+    r = _mm_add_ps(r, _mm_mul_ps(a->columns[1].m, _mm_set1_ps(v.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(a->columns[2].m, _mm_set1_ps(v.z)));
+    return vec3_from_vec3a((Vec3A){.m = r});
+#else
+    const Vec3A* c = a->columns;
+    return (Vec3){
+        c[0].x * v.x + c[1].x * v.y + c[2].x * v.z,
+        c[0].y * v.x + c[1].y * v.y + c[2].y * v.z,
+        c[0].z * v.x + c[1].z * v.y + c[2].z * v.z
+    };
+#endif
+}
+
+static inline Vec3 affine_transform_point(const Affine3x4* a, Vec3 p) {
+#ifdef __SSE__
+    __m128 r = _mm_mul_ps(a->columns[0].m, _mm_set1_ps(p.x));
+    r = _mm_add_ps(r, _mm_mul_ps(a->columns[1].m, _mm_set1_ps(p.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(a->columns[2].m, _mm_set1_ps(p.z)));
+    return vec3_from_vec3a((Vec3A){.m = _mm_add_ps(r, a->columns[3].m)});
+#else
+    return vec3_add(affine_transform_vector(a, p), vec3_from_vec3a(a->columns[3]));
+#endif
+}
+
+// Inverse of a rotation plus translation: transpose the rotation and rotate the negated translation.
+// Only valid for rigid transforms, which is all a mesh Transform can express.
+static inline Affine3x4 affine_rigid_inverse(const Affine3x4* a) {
+    Affine3x4 inv;
+#ifdef __SSE__
+    __m128 c0 = a->columns[0].m, c1 = a->columns[1].m, c2 = a->columns[2].m, c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    inv.columns[0].m = c0;
+    inv.columns[1].m = c1;
+    inv.columns[2].m = c2;
+    inv.columns[3].m = _mm_setzero_ps();
+#else
+    const Vec3A* c = a->columns;
+    inv.columns[0] = (Vec3A){.x = c[0].x, .y = c[1].x, .z = c[2].x};
+    inv.columns[1] = (Vec3A){.x = c[0].y, .y = c[1].y, .z = c[2].y};
+    inv.columns[2] = (Vec3A){.x = c[0].z, .y = c[1].z, .z = c[2].z};
+    inv.columns[3] = (Vec3A){.x = 0.0f};
+#endif
+    Vec3 t = affine_transform_vector(&inv, vec3_from_vec3a(a->columns[3]));
+    inv.columns[3] = vec3a_from_vec3(vec3_mul(t, -1.0f));
+    return inv;
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "affine.h"
+#include "utils/stats.h"
 #include <stdbool.h>
 
 typedef struct { 
@@ -15,9 +17,48 @@ typedef struct {
 } Transform;
 
 // Ray operations
+Mat4 transform_to_matrix(Transform transform);
+Affine3x4 transform_to_affine(Transform transform);
 Ray transform_ray(Ray ray, Transform transform);
 Vec3 transform_normal(Vec3 normal, Transform transform);
-bool ray_triangle_intersect(Ray ray, Vec3 v0, Vec3 v1, Vec3 v2, 
-                          float* t, float* u_out, float* v_out);
+
+// World to object space with a precomputed inverse, e.g. a mesh's cached matrix
+static inline Ray affine_transform_ray(Ray ray, const Affine3x4* world_to_object) {
+    return (Ray){
+        affine_transform_point(world_to_object, ray.origin),
+        vec3_normalize(affine_transform_vector(world_to_object, ray.direction))
+    };
+}
+
+// Moller-Trumbore, inline so leaf loops keep the ray in registers
+static inline bool ray_triangle_intersect(Ray ray, Vec3 v0, Vec3 v1, Vec3 v2,
+                                          float* t, float* u_out, float* v_out) {
+    const float EPSILON = 0.0000001f;
+    STATS_INC(triangle_tests);
+    Vec3 edge1 = vec3_sub(v1, v0);
+    Vec3 edge2 = vec3_sub(v2, v0);
+    Vec3 h = vec3_cross(ray.direction, edge2);
+    float a = vec3_dot(edge1, h);
+
+    if (a > -EPSILON && a < EPSILON) return false;
+
+    float f = 1.0f / a;
+    Vec3 s = vec3_sub(ray.origin, v0);
+    float u = f * vec3_dot(s, h);
+
+    if (u < 0.0f || u > 1.0f) return false;
+
+    Vec3 q = vec3_cross(s, edge1);
+    float v = f * vec3_dot(ray.direction, q);
+
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    *t = f * vec3_dot(edge2, q);
+    *u_out = u;
+    *v_out = v;
+    if (!(*t > EPSILON)) return false;
+    STATS_INC(triangle_hits);
+    return true;
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include "query.h"
+
+Scene create_query_scene(void) {
+    // A single 1x1 frame, nothing is rendered
+    return create_scene(1, 1, 1000, 1, 1.0f);
+}
+
+void intersect_scene_rays(const Scene* scene, const Ray* rays, size_t count, SceneHit* hits) {
+    #pragma omp parallel for schedule(dynamic, 64) if (count >= QUERY_PARALLEL_THRESHOLD)
+    for (size_t i = 0; i < count; i++) {
+        intersect_scene(scene, rays[i], &hits[i]);
+    }
+}
+
+void occluded_scene_rays(const Scene* scene, const Ray* rays, const float* max_distances,
+                         size_t count, bool* occluded) {
+    #pragma omp parallel for schedule(dynamic, 64) if (count >= QUERY_PARALLEL_THRESHOLD)
+    for (size_t i = 0; i < count; i++) {
+        occluded[i] = occluded_scene_within(scene, rays[i], max_distances ? max_distances[i] : 1e30f);
+    }
+}
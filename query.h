@@ -0,0 +1,18 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "scene.h"
+
+#define QUERY_PARALLEL_THRESHOLD 1024  // Smaller batches run on the calling thread
+
+// Scene without render targets, for callers that only add meshes and query them
+Scene create_query_scene(void);
+
+// Batched ray queries. They only read the scene, so any number of threads may call
+// them at once as long as no mesh is added or moved meanwhile. Misses get mesh_index -1.
+void intersect_scene_rays(const Scene* scene, const Ray* rays, size_t count, SceneHit* hits);
+// max_distances may be NULL for unbounded rays
+void occluded_scene_rays(const Scene* scene, const Ray* rays, const float* max_distances,
+                         size_t count, bool* occluded);
+
+#endif
@@ -1,75 +1,426 @@
 #include "scene.h"
+#include "demo.h"
+#include "checkpoint.h"
+#include "wavefront.h"
+#include "server.h"
+#include "frame_cache.h"
 #include <time.h>
+#include <string.h>
+#include <omp.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+#define MAX_MERGE_DIRS 256
+
+typedef struct {
+    float frame_budget_ms;      // Frame time budget for preview renders, 0 keeps the resolution fixed
+    bool heatmap;
+    bool visibility_buffer;
+    bool wavefront;             // Render stage by stage over ray queues
+    bool sort_rays;
+    bool numa;                  // Pin threads and keep mesh copies on every NUMA node
+    const char* preview_filename; // Rewritten after every progressive pass
+    const char* trace_filename;
+    int first_frame;            // Frame range to render, last_frame is exclusive, -1 for all
+    int last_frame;
+    int frame_step;
+    const char* shard_dir;      // Write finished frames here instead of an animation
+    const char* merge_dirs[MAX_MERGE_DIRS];
+    int merge_dir_count;
+    const char* output_filename;
+    const char* checkpoint_dir; // Periodically store finished frames here
+    int checkpoint_interval;
+    bool resume;
+    const char* socket_path;    // Serve render jobs instead of rendering the animation
+    const char* cache_dir;      // Reuse frames whose inputs were rendered before
+    const char* out_of_core_dir; // Page mesh geometry out to files here and trace through a bounded cache
+    size_t page_budget;         // Page cache bytes per mesh
+} Options;
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --frame-budget MS          adapt the render resolution to a frame time budget\n"
+        "  --heatmap                  write a traversal cost heatmap (needs make STATS=1)\n"
+        "  --visibility-buffer        rasterize primary hits, trace only shadow rays\n"
+        "  --wavefront                render through per-stage ray queues, print stage throughput\n"
+        "  --sort-rays                group wavefront shadow rays by mesh before tracing\n"
+        "  --numa                     pin render threads and replicate meshes per NUMA node\n"
+        "  --preview FILE             render coarse-to-fine, updating FILE after each pass\n"
+        "  --trace FILE               write stage and thread timings as Chrome trace JSON\n"
+        "  --frames START:END[:STEP]  render only frames START <= f < END, every STEP-th\n"
+        "  --shard-dir DIR            write rendered frames to DIR instead of an animation\n"
+        "  --merge DIR                assemble the animation from shard directories, repeatable\n"
+        "  --output FILE              animation file name (default: timestamped)\n"
+        "  --checkpoint DIR           store finished frames and a manifest in DIR\n"
+        "  --checkpoint-interval N    frames per checkpoint write (default 1)\n"
+        "  --resume                   skip frames already checkpointed in DIR\n"
+        "  --serve SOCKET             keep the scene loaded and render jobs sent to a Unix socket\n"
+        "  --cache DIR                skip frames whose inputs match a frame cached in DIR\n"
+        "  --out-of-core DIR          page mesh geometry out to DIR, keep only a page cache in memory\n"
+        "  --page-budget MB           page cache size per mesh for --out-of-core (default 64)\n",
+        program);
+}
+
+static bool parse_frame_range(const char* text, Options* options) {
+    int count = sscanf(text, "%d:%d:%d", &options->first_frame, &options->last_frame, &options->frame_step);
+    if (count < 2) return false;
+    if (count < 3) options->frame_step = 1;
+    return options->first_frame >= 0 && options->frame_step > 0;
+}
+
+static bool parse_options(int argc, char** argv, Options* options) {
+    *options = (Options){
+        .frame_budget_ms = 0.0f,
+        .first_frame = 0,
+        .last_frame = -1,
+        .frame_step = 1,
+        .checkpoint_interval = 1,
+        .page_budget = PAGED_DEFAULT_BUDGET
+    };
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--frame-budget") == 0 && has_value) {
+            options->frame_budget_ms = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--heatmap") == 0) {
+            options->heatmap = true;
+        } else if (strcmp(argv[i], "--visibility-buffer") == 0) {
+            options->visibility_buffer = true;
+        } else if (strcmp(argv[i], "--wavefront") == 0) {
+            options->wavefront = true;
+        } else if (strcmp(argv[i], "--sort-rays") == 0) {
+            options->wavefront = true;
+            options->sort_rays = true;
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            options->numa = true;
+        } else if (strcmp(argv[i], "--preview") == 0 && has_value) {
+            options->preview_filename = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && has_value) {
+            options->trace_filename = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            if (!parse_frame_range(argv[++i], options)) return false;
+        } else if (strcmp(argv[i], "--shard-dir") == 0 && has_value) {
+            options->shard_dir = argv[++i];
+        } else if (strcmp(argv[i], "--merge") == 0 && has_value && options->merge_dir_count < MAX_MERGE_DIRS) {
+            options->merge_dirs[options->merge_dir_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            options->output_filename = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && has_value) {
+            options->checkpoint_dir = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && has_value) {
+            options->checkpoint_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            options->resume = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && has_value) {
+            options->socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && has_value) {
+            options->cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--out-of-core") == 0 && has_value) {
+            options->out_of_core_dir = argv[++i];
+        } else if (strcmp(argv[i], "--page-budget") == 0 && has_value) {
+            options->page_budget = (size_t)(atof(argv[++i]) * (1 << 20));
+        } else {
+            return false;
+        }
+    }
+    return !options->resume || options->checkpoint_dir;
+}
+
+// Replace the preview image with the current pass, renamed into place so viewers never see a partial file
+static void write_preview(const Scene* scene, int pass, int step, void* user_data) {
+    (void)pass;
+    (void)step;
+    const char* filename = (const char*)user_data;
+    uint8_t* output = NULL;
+    size_t size = WebPEncodeRGB(scene->frames[scene->current_frame], scene->width, scene->height,
+                                scene->width * 3, 90.0f, &output);
+    if (size == 0) return;
+
+    char tmp_filename[1024];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    FILE* fp = fopen(tmp_filename, "wb");
+    if (fp) {
+        bool written = fwrite(output, size, 1, fp) == 1;
+        fclose(fp);
+        if (written) rename(tmp_filename, filename);
+    }
+    WebPFree(output);
+}
+
+// Write every mesh to a paged geometry file and drop its resident triangles
+static bool page_out_scene(Scene* scene, const Options* options) {
+    if (!create_frame_directory(options->out_of_core_dir)) return false;
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s/mesh_%zu.rtpg", options->out_of_core_dir, m);
+        if (!page_out_mesh(&scene->meshes[m], filename, options->page_budget)) return false;
+    }
+    return true;
+}
+
+static void print_page_cache_stats(const Scene* scene) {
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        const Mesh* mesh = &scene->meshes[m];
+        if (mesh->accel.type != ACCEL_PAGED) continue;
+        PageCacheStats stats = get_page_cache_stats(mesh->accel.paged);
+        uint64_t lookups = stats.hits + stats.misses;
+        printf("Mesh %zu page cache: %llu hits, %llu misses, %llu evictions (%.1f%% hit rate)\n", m,
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               (unsigned long long)stats.evictions, lookups > 0 ? 100.0 * stats.hits / lookups : 0.0);
+    }
+}
+
+// Demo scene with the render features selected on the command line
+static bool configure_scene(Scene* scene, const Options* options) {
+    // Set up camera, light and meshes
+    setup_demo_scene(scene);
+
+    // Keep geometry on disk, only the upper BVH levels and a bounded set of pages stay in memory
+    if (options->out_of_core_dir && !page_out_scene(scene, options)) return false;
+
+    // Only re-trace the parts of each frame touched by moving meshes
+    set_scene_incremental(scene, true);
+
+    // Skip shadow tests against meshes that cannot occlude a point
+    set_scene_occluder_map(scene, true);
+
+    // Show a coarse image first and refine it while the frame renders
+    if (options->preview_filename) {
+        set_scene_progressive(scene, true, write_preview, (void*)options->preview_filename);
+    }
+
+    // Optionally find primary hits with the rasterizer
+    set_scene_visibility_buffer(scene, options->visibility_buffer);
+    if (options->visibility_buffer && options->out_of_core_dir) {
+        fprintf(stderr, "Paged meshes are not rasterized, tracing primary rays instead of --visibility-buffer\n");
+    }
+
+    // Adapt the render resolution to the frame time budget, down to a quarter of the output size
+    set_scene_dynamic_resolution(scene, options->frame_budget_ms, 0.25f);
+
+    // Record per-pixel traversal cost next to the render
+    set_scene_heatmap(scene, options->heatmap);
+
+    // Keep render threads and the data they read on the same NUMA node. The render server
+    // pins from its worker thread instead, which would otherwise inherit a single-CPU mask.
+    set_scene_numa(scene, options->numa && !options->socket_path);
+    return true;
+}
+
+// Per-frame output once a frame is final, whether rendered or taken from the cache
+static bool finish_frame(Scene* scene, const Options* options, Checkpoint* checkpoint, int frame) {
+    // Shards keep every finished frame on disk for the merge step
+    bool ok = true;
+    if (options->shard_dir) ok = save_scene_frame(scene, frame, options->shard_dir);
+    if (ok && options->checkpoint_dir) ok = checkpoint_frame(checkpoint, scene, frame);
+    return ok;
+}
+
+// Load every frame from whichever shard directory holds it
+static bool merge_shards(Scene* scene, const Options* options) {
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        char filename[1024];
+        bool loaded = false;
+        for (int d = 0; d < options->merge_dir_count && !loaded; d++) {
+            get_frame_filename(filename, sizeof(filename), options->merge_dirs[d], frame);
+            FILE* fp = fopen(filename, "rb");
+            if (!fp) continue;
+            fclose(fp);
+            if (!load_scene_frame(scene, frame, options->merge_dirs[d])) return false;
+            loaded = true;
+        }
+        if (!loaded) {
+            fprintf(stderr, "Frame %d is missing from all shard directories\n", frame);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+#ifndef RAYTRACER_STATS
+    if (options.heatmap) {
+        fprintf(stderr, "Cost heatmaps need traversal counters, rebuild with make STATS=1\n");
+        return 1;
+    }
 #endif
 
-int main() {
+    // Cached frames carry no traversal costs, the heatmap needs every frame traced
+    if (options.heatmap && options.cache_dir) {
+        fprintf(stderr, "--heatmap traces every frame, ignoring --cache\n");
+        options.cache_dir = NULL;
+    }
+
     // Create scene with 4 seconds duration at 24 fps and a scaling factor of 0.9
     Scene scene = create_scene(800, 600, 4000, 24, 0.9f);
-    
-    // Set up camera
-    set_scene_camera(&scene,
-        (Vec3){-3.0f, 3.0f, -3.0f},
-        (Vec3){0.0f, 0.0f, 0.0f},
-        (Vec3){0.0f, 1.0f, 0.0f},
-        60.0f
-    );
-    
-    // Set up light
-    set_scene_light(&scene,
-        (Vec3){1.0f, 1.0f, -1.0f},     // Direction
-        (Vec3){1.4f, 1.4f, 1.4f}       // White light
-    );
-    
-    // Add meshes to scene
-    Mesh drone = create_mesh("assets/drone.obj", "assets/drone.webp");
-    add_mesh_to_scene(&scene, drone);
-    
-    Mesh treasure = create_mesh("assets/treasure.obj", "assets/treasure.webp");
-    add_mesh_to_scene(&scene, treasure);
-    
-    Mesh ground = create_mesh("assets/ground.obj", "assets/ground.webp");
-    add_mesh_to_scene(&scene, ground);
-
-    // Initialize timer for progress bar
-    clock_t start_time = clock();
-
-    // Render each frame
-    for (int frame = 0; frame < scene.frame_count; frame++) {
-        float t = frame * (2.0f * M_PI / 120.0f);
-        
-        // Animate drone
-        set_mesh_position(&scene.meshes[0], 
-            (Vec3){2.0f * cosf(t), 1.0f + 0.2f * sinf(2*t), 2.0f * sinf(t)});
-        set_mesh_rotation(&scene.meshes[0], 
-            (Vec3){0.1f * sinf(t), t, 0.1f * cosf(t)});
-        
-        // Animate treasure
-        set_mesh_position(&scene.meshes[1], 
-            (Vec3){1.0f, 0.5f + 0.1f * sinf(t), 1.0f});
-        set_mesh_rotation(&scene.meshes[1], 
-            (Vec3){0, t * 0.5f, 0});
-            
-        // Render frame
-        render_scene(&scene);
-        next_frame(&scene);
-        
-        // Update progress bar
-        update_progress_bar(frame, scene.frame_count, start_time);
-    }
-
-    // Save all frames as animated WebP
+
+    if (options.last_frame < 0 || options.last_frame > scene.frame_count) {
+        options.last_frame = scene.frame_count;
+    }
+    if (options.shard_dir && !create_frame_directory(options.shard_dir)) {
+        destroy_scene(&scene);
+        return 1;
+    }
+
+    // Record stage and thread timings for a trace-event export
+    Telemetry telemetry = create_telemetry(omp_get_max_threads());
+    if (options.trace_filename) set_scene_telemetry(&scene, &telemetry);
+
+    // Queue-based renderer, reports throughput per stage at the end
+    Wavefront wavefront = create_wavefront(options.sort_rays);
+    if (options.wavefront) set_scene_wavefront(&scene, &wavefront);
+
+    bool ok = true;
+    if (options.merge_dir_count > 0) {
+        // Frames were rendered by other processes, only assemble them
+        ok = merge_shards(&scene, &options);
+    } else if (options.socket_path) {
+        // Keep meshes, BVHs and textures resident and render jobs from the socket until shutdown
+        ok = configure_scene(&scene, &options);
+        RenderServer server;
+        if (ok) ok = open_render_server(&server, &scene, animate_demo_scene, options.socket_path,
+                                      options.numa);
+        if (ok) {
+            printf("Listening on %s\n", options.socket_path);
+            fflush(stdout);
+            run_render_server(&server);
+            close_render_server(&server);
+        }
+    } else {
+        ok = configure_scene(&scene, &options);
+
+        // Pick up frames that survived an earlier, interrupted run
+        Checkpoint checkpoint = {0};
+        if (ok && options.checkpoint_dir) {
+            ok = open_checkpoint(&checkpoint, &scene, options.checkpoint_dir,
+                                 options.checkpoint_interval, options.resume);
+        }
+
+        // Initialize timer for progress bar
+        double start_time = get_time_seconds();
+        int total = (options.last_frame - options.first_frame + options.frame_step - 1) / options.frame_step;
+        int done = 0;
+
+        // Frames are keyed by a hash of everything they depend on
+        FrameCache cache;
+        if (ok && options.cache_dir) ok = open_frame_cache(&cache, &scene, options.cache_dir);
+
+        // Snapshots of the frames in flight, small frames render several at a time
+        int max_batch = omp_get_max_threads();
+        FrameState* states = (FrameState*)calloc(max_batch, sizeof(FrameState));
+        uint64_t* keys = (uint64_t*)calloc(max_batch, sizeof(uint64_t));
+
+        // Frames whose key repeats one already in the batch, copied from it after rendering
+        int* duplicate_frames = (int*)calloc(max_batch, sizeof(int));
+        int* duplicate_sources = (int*)calloc(max_batch, sizeof(int));
+
+        // Render each frame of the requested range
+        int frame = options.first_frame;
+        while (frame < options.last_frame && ok) {
+            int batch_size = get_scene_frame_batch_size(&scene);
+            int count = 0;
+            int duplicate_count = 0;
+            for (; frame < options.last_frame && count < batch_size && duplicate_count < max_batch && ok;
+                 frame += options.frame_step) {
+                if (is_frame_checkpointed(&checkpoint, frame)) {
+                    if (options.shard_dir) ok = save_scene_frame(&scene, frame, options.shard_dir);
+                    update_progress_bar(done++, total, start_time);
+                    continue;
+                }
+
+                double animate_start = get_time_seconds();
+                animate_demo_scene(&scene, frame);
+                if (options.trace_filename) {
+                    record_telemetry_event(&telemetry, STAGE_ANIMATE, frame, 0, animate_start, get_time_seconds());
+                }
+
+                // Unchanged inputs, take the frame from the cache instead of rendering it
+                if (options.cache_dir) {
+                    keys[count] = hash_frame_inputs(&cache, &scene);
+                    int source = 0;
+                    while (source < count && keys[source] != keys[count]) source++;
+                    if (source < count) {
+                        duplicate_frames[duplicate_count] = frame;
+                        duplicate_sources[duplicate_count++] = source;
+                        continue;
+                    }
+                    if (load_cached_frame(&cache, &scene, frame, keys[count])) {
+                        ok = finish_frame(&scene, &options, &checkpoint, frame);
+                        update_progress_bar(done++, total, start_time);
+                        continue;
+                    }
+                }
+                capture_frame_state(&scene, frame, &states[count++]);
+            }
+
+            // Render the batch
+            render_scene_frames(&scene, states, count);
+
+            for (int i = 0; i < count && ok; i++) {
+                if (options.cache_dir) ok = store_cached_frame(&cache, &scene, states[i].frame, keys[i]);
+                if (ok) ok = finish_frame(&scene, &options, &checkpoint, states[i].frame);
+
+                // Update progress bar
+                update_progress_bar(done++, total, start_time);
+            }
+
+            for (int i = 0; i < duplicate_count && ok; i++) {
+                copy_cached_frame(&cache, &scene, duplicate_frames[i], states[duplicate_sources[i]].frame);
+                ok = finish_frame(&scene, &options, &checkpoint, duplicate_frames[i]);
+                update_progress_bar(done++, total, start_time);
+            }
+        }
+
+        for (int i = 0; i < max_batch; i++) destroy_frame_state(&states[i]);
+        free(states);
+        free(keys);
+        free(duplicate_frames);
+        free(duplicate_sources);
+
+        if (options.cache_dir) {
+            printf("\nFrame cache: %d frames reused, %d rendered\n", cache.hits, cache.misses);
+        }
+
+        if (options.checkpoint_dir) close_checkpoint(&checkpoint, &scene);
+    }
+
     char filename[64];
     time_t current_time = time(NULL);
-    strftime(filename, sizeof(filename), "%Y%m%d_%H%M%S_rendering.webp", localtime(&current_time));
-    save_scene(&scene, filename);
+    if (ok && !options.shard_dir && !options.socket_path) {
+        // Save all frames as animated WebP
+        strftime(filename, sizeof(filename), "%Y%m%d_%H%M%S_rendering.webp", localtime(&current_time));
+        save_scene(&scene, options.output_filename ? options.output_filename : filename);
+    }
+
+    if (ok && options.heatmap && !options.socket_path) {
+        strftime(filename, sizeof(filename), "%Y%m%d_%H%M%S_heatmap.webp", localtime(&current_time));
+        save_scene_heatmap(&scene, filename);
+    }
+
+#ifdef RAYTRACER_STATS
+    print_traversal_stats(&scene.stats);
+#endif
+
+    if (options.wavefront) print_wavefront_stats(&wavefront);
+
+    if (options.out_of_core_dir) print_page_cache_stats(&scene);
+
+    if (options.trace_filename) {
+        export_telemetry_trace(&telemetry, options.trace_filename);
+        print_telemetry_summary(&telemetry);
+    }
 
     // Cleanup
-    destroy_mesh(&drone);
-    destroy_mesh(&treasure);
-    destroy_mesh(&ground);
+    for (size_t m = 0; m < scene.mesh_count; m++) {
+        destroy_mesh(&scene.meshes[m]);
+    }
     destroy_scene(&scene);
-    return 0;
-}
\ No newline at end of file
+    destroy_telemetry(&telemetry);
+    destroy_wavefront(&wavefront);
+    return ok ? 0 : 1;
+}
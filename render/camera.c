@@ -27,4 +27,23 @@ Ray get_camera_ray(const Camera* camera, float x, float y, float aspect) {
     ));
 
     return (Ray){camera->position, ray_dir};
+}
+
+bool project_camera_point(const Camera* camera, Vec3 point, float aspect, float* x, float* y) {
+    Vec3 forward = vec3_normalize(vec3_sub(camera->look_at, camera->position));
+    Vec3 right = vec3_normalize(vec3_cross(forward, camera->up));
+    Vec3 camera_up = vec3_cross(right, forward);
+
+    // Points on or behind the camera plane have no valid projection
+    Vec3 offset = vec3_sub(point, camera->position);
+    float depth = vec3_dot(offset, forward);
+    if (depth < 1e-4f) return false;
+
+    // Inverse of the mapping in get_camera_ray
+    float scale = tanf((camera->fov * 0.5f) * M_PI / 180.0f);
+    float ray_x = vec3_dot(offset, right) / depth;
+    float ray_y = vec3_dot(offset, camera_up) / depth;
+    *x = (ray_x / (aspect * scale) + 1.0f) * 0.5f;
+    *y = (1.0f - ray_y / scale) * 0.5f;
+    return true;
 }
\ No newline at end of file
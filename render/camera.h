@@ -14,5 +14,6 @@ typedef struct {
 // Camera operations
 Camera create_camera(Vec3 position, Vec3 look_at, Vec3 up, float fov);
 Ray get_camera_ray(const Camera* camera, float x, float y, float aspect);
+bool project_camera_point(const Camera* camera, Vec3 point, float aspect, float* x, float* y);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "dirty.h"
+#include <string.h>
+#include <math.h>
+
+DirtyTracker create_dirty_tracker(int width, int height) {
+    DirtyTracker tracker;
+    tracker.width = width;
+    tracker.height = height;
+    tracker.tiles_x = (width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    tracker.tiles_y = (height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    tracker.tiles = (unsigned char*)malloc(tracker.tiles_x * tracker.tiles_y);
+    memset(tracker.tiles, 1, tracker.tiles_x * tracker.tiles_y);
+    tracker.transforms = NULL;
+    tracker.mesh_count = 0;
+    tracker.lights = NULL;
+    tracker.light_count = 0;
+    tracker.last_frame = -1;
+    return tracker;
+}
+
+static bool transforms_equal(Transform a, Transform b) {
+    return a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+           a.rotation.x == b.rotation.x && a.rotation.y == b.rotation.y && a.rotation.z == b.rotation.z;
+}
+
+static bool cameras_equal(const Camera* a, const Camera* b) {
+    return a->position.x == b->position.x && a->position.y == b->position.y && a->position.z == b->position.z &&
+           a->look_at.x == b->look_at.x && a->look_at.y == b->look_at.y && a->look_at.z == b->look_at.z &&
+           a->up.x == b->up.x && a->up.y == b->up.y && a->up.z == b->up.z &&
+           a->fov == b->fov;
+}
+
+static bool lights_equal(const DirectionalLight* a, const DirectionalLight* b) {
+    return a->direction.x == b->direction.x && a->direction.y == b->direction.y && a->direction.z == b->direction.z &&
+           a->color.x == b->color.x && a->color.y == b->color.y && a->color.z == b->color.z;
+}
+
+// Light structs hold only 4-byte fields, so they have no padding to compare
+static bool local_lights_equal(const Light* a, const Light* b, size_t count) {
+    return count == 0 || memcmp(a, b, count * sizeof(Light)) == 0;
+}
+
+static void mark_all_tiles(DirtyTracker* tracker) {
+    memset(tracker->tiles, 1, tracker->tiles_x * tracker->tiles_y);
+}
+
+static Vec3 get_box_corner(AABB box, int i) {
+    return (Vec3){
+        (i & 1) ? box.max.x : box.min.x,
+        (i & 2) ? box.max.y : box.min.y,
+        (i & 4) ? box.max.z : box.min.z
+    };
+}
+
+// Mark the screen-space bounds of a set of world points
+static void mark_points(DirtyTracker* tracker, const Camera* camera, const Vec3* points, int count) {
+    float aspect = (float)tracker->width / tracker->height;
+    float min_x = 1e30f, min_y = 1e30f;
+    float max_x = -1e30f, max_y = -1e30f;
+
+    for (int i = 0; i < count; i++) {
+        float x, y;
+        if (!project_camera_point(camera, points[i], aspect, &x, &y)) {
+            // Footprint crosses the camera plane, no tight bound exists
+            mark_all_tiles(tracker);
+            return;
+        }
+        min_x = fminf(min_x, x);
+        min_y = fminf(min_y, y);
+        max_x = fmaxf(max_x, x);
+        max_y = fmaxf(max_y, y);
+    }
+
+    // Convert to pixel indices with a one pixel safety margin
+    int x0 = (int)floorf(min_x * tracker->width - 0.5f) - 1;
+    int y0 = (int)floorf(min_y * tracker->height - 0.5f) - 1;
+    int x1 = (int)ceilf(max_x * tracker->width - 0.5f) + 1;
+    int y1 = (int)ceilf(max_y * tracker->height - 0.5f) + 1;
+    if (x1 < 0 || y1 < 0 || x0 >= tracker->width || y0 >= tracker->height) return;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= tracker->width) x1 = tracker->width - 1;
+    if (y1 >= tracker->height) y1 = tracker->height - 1;
+
+    for (int ty = y0 / DIRTY_TILE_SIZE; ty <= y1 / DIRTY_TILE_SIZE; ty++) {
+        for (int tx = x0 / DIRTY_TILE_SIZE; tx <= x1 / DIRTY_TILE_SIZE; tx++) {
+            tracker->tiles[ty * tracker->tiles_x + tx] = 1;
+        }
+    }
+}
+
+// Mark the screen-space footprint of a box swept along the shadow direction
+static void mark_footprint(DirtyTracker* tracker, const Camera* camera, AABB box, Vec3 shadow_offset) {
+    Vec3 points[16];
+    for (int i = 0; i < 8; i++) {
+        points[i] = get_box_corner(box, i);
+        points[i + 8] = vec3_add(points[i], shadow_offset);
+    }
+    mark_points(tracker, camera, points, 16);
+}
+
+// Mark the box and its shadow cast away from a point or spot light. A shadow point lies at most
+// reach beyond its occluder, so scaling the box about the light by 1 + reach / distance covers it.
+static void mark_local_light_footprint(DirtyTracker* tracker, const Camera* camera, AABB box,
+                                       Vec3 light_position, float reach) {
+    Vec3 nearest = {
+        fminf(fmaxf(light_position.x, box.min.x), box.max.x),
+        fminf(fmaxf(light_position.y, box.min.y), box.max.y),
+        fminf(fmaxf(light_position.z, box.min.z), box.max.z)
+    };
+    float distance = vec3_length(vec3_sub(nearest, light_position));
+    if (distance < reach * 1e-3f) {
+        // Light inside or touching the box, the shadow can fall anywhere
+        mark_all_tiles(tracker);
+        return;
+    }
+
+    float scale = 1.0f + reach / distance;
+    Vec3 points[16];
+    for (int i = 0; i < 8; i++) {
+        points[i] = get_box_corner(box, i);
+        points[i + 8] = vec3_add(light_position, vec3_mul(vec3_sub(points[i], light_position), scale));
+    }
+    mark_points(tracker, camera, points, 16);
+}
+
+// Where a mesh box and every shadow it casts can show up
+static void mark_shadowed_footprint(DirtyTracker* tracker, const Camera* camera, AABB box, Vec3 shadow_offset,
+                                    const Light* lights, size_t light_count, float reach) {
+    mark_footprint(tracker, camera, box, shadow_offset);
+    for (size_t l = 0; l < light_count; l++) {
+        mark_local_light_footprint(tracker, camera, box, lights[l].position, reach);
+    }
+}
+
+bool update_dirty_tracker(DirtyTracker* tracker, const Mesh* meshes, size_t mesh_count,
+                          const Camera* camera, const DirectionalLight* light,
+                          const Light* lights, size_t light_count,
+                          int frame, int width, int height) {
+    if (width != tracker->width || height != tracker->height) {
+        destroy_dirty_tracker(tracker);
+        *tracker = create_dirty_tracker(width, height);
+    }
+
+    // Incremental rendering needs the previous frame with the same camera, light and meshes
+    bool incremental = tracker->last_frame >= 0 &&
+                       (tracker->last_frame == frame || tracker->last_frame == frame - 1) &&
+                       tracker->mesh_count == mesh_count &&
+                       cameras_equal(&tracker->camera, camera) &&
+                       lights_equal(&tracker->light, light) &&
+                       tracker->light_count == light_count &&
+                       local_lights_equal(tracker->lights, lights, light_count);
+
+    if (incremental) {
+        memset(tracker->tiles, 0, tracker->tiles_x * tracker->tiles_y);
+
+        // Shadows of a mesh can only land on geometry inside the scene bounds
+        AABB scene_bounds = create_empty_aabb();
+        for (size_t m = 0; m < mesh_count; m++) {
+            scene_bounds = merge_aabb(scene_bounds, get_mesh_world_bounds(&meshes[m], meshes[m].transform));
+            scene_bounds = merge_aabb(scene_bounds, get_mesh_world_bounds(&meshes[m], tracker->transforms[m]));
+        }
+        float reach = vec3_length(vec3_sub(scene_bounds.max, scene_bounds.min));
+        Vec3 shadow_offset = vec3_mul(light->direction, -reach);
+
+        // Re-trace both where moved meshes were and where they are now
+        for (size_t m = 0; m < mesh_count; m++) {
+            if (transforms_equal(meshes[m].transform, tracker->transforms[m])) continue;
+            mark_shadowed_footprint(tracker, camera, get_mesh_world_bounds(&meshes[m], tracker->transforms[m]),
+                                    shadow_offset, lights, light_count, reach);
+            mark_shadowed_footprint(tracker, camera, get_mesh_world_bounds(&meshes[m], meshes[m].transform),
+                                    shadow_offset, lights, light_count, reach);
+        }
+    } else {
+        mark_all_tiles(tracker);
+    }
+
+    // Remember the state this frame is rendered with
+    if (tracker->mesh_count != mesh_count) {
+        tracker->transforms = (Transform*)realloc(tracker->transforms, mesh_count * sizeof(Transform));
+        tracker->mesh_count = mesh_count;
+    }
+    for (size_t m = 0; m < mesh_count; m++) {
+        tracker->transforms[m] = meshes[m].transform;
+    }
+    if (tracker->light_count != light_count) {
+        tracker->lights = (Light*)realloc(tracker->lights, light_count * sizeof(Light));
+        tracker->light_count = light_count;
+    }
+    if (light_count > 0) memcpy(tracker->lights, lights, light_count * sizeof(Light));
+    tracker->camera = *camera;
+    tracker->light = *light;
+    tracker->last_frame = frame;
+
+    return incremental;
+}
+
+bool is_tile_dirty(const DirtyTracker* tracker, int tile_x, int tile_y) {
+    return tracker->tiles[tile_y * tracker->tiles_x + tile_x] != 0;
+}
+
+void invalidate_dirty_tracker(DirtyTracker* tracker) {
+    tracker->last_frame = -1;
+}
+
+void destroy_dirty_tracker(DirtyTracker* tracker) {
+    free(tracker->tiles);
+    free(tracker->transforms);
+    free(tracker->lights);
+    tracker->tiles = NULL;
+    tracker->transforms = NULL;
+    tracker->lights = NULL;
+    tracker->mesh_count = 0;
+    tracker->light_count = 0;
+}
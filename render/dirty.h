@@ -0,0 +1,36 @@
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include "geometry/mesh.h"
+#include "render/camera.h"
+#include "render/light.h"
+#include <stdbool.h>
+
+#define DIRTY_TILE_SIZE 16
+
+typedef struct {
+    unsigned char* tiles;       // One flag per tile, non-zero if it must be re-traced
+    int tiles_x;
+    int tiles_y;
+    int width;
+    int height;
+    Transform* transforms;      // Mesh transforms of the last rendered frame
+    size_t mesh_count;
+    Camera camera;
+    DirectionalLight light;
+    Light* lights;              // Point and spot lights of the last rendered frame
+    size_t light_count;
+    int last_frame;             // Index of the last rendered frame, -1 if none
+} DirtyTracker;
+
+// Dirty region tracking
+DirtyTracker create_dirty_tracker(int width, int height);
+bool update_dirty_tracker(DirtyTracker* tracker, const Mesh* meshes, size_t mesh_count,
+                          const Camera* camera, const DirectionalLight* light,
+                          const Light* lights, size_t light_count,
+                          int frame, int width, int height);
+bool is_tile_dirty(const DirtyTracker* tracker, int tile_x, int tile_y);
+void invalidate_dirty_tracker(DirtyTracker* tracker);
+void destroy_dirty_tracker(DirtyTracker* tracker);
+
+#endif
@@ -0,0 +1,30 @@
+#include "gbuffer.h"
+
+GBuffer create_gbuffer(void) {
+    GBuffer buffer;
+    buffer.samples = NULL;
+    buffer.width = 0;
+    buffer.height = 0;
+    buffer.sample_capacity = 0;
+    buffer.frame = -1;
+    return buffer;
+}
+
+void resize_gbuffer(GBuffer* buffer, int width, int height) {
+    size_t count = (size_t)width * height;
+    if (count > buffer->sample_capacity) {
+        buffer->samples = (GBufferSample*)realloc(buffer->samples, count * sizeof(GBufferSample));
+        buffer->sample_capacity = count;
+    }
+    if (buffer->width != width || buffer->height != height) buffer->frame = -1;
+    buffer->width = width;
+    buffer->height = height;
+}
+
+void destroy_gbuffer(GBuffer* buffer) {
+    free(buffer->samples);
+    buffer->samples = NULL;
+    buffer->sample_capacity = 0;
+    buffer->width = buffer->height = 0;
+    buffer->frame = -1;
+}
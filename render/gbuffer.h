@@ -0,0 +1,30 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "math/vec3.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+    int mesh_index;             // -1 for background pixels
+    int triangle_index;
+    float u, v;                 // Barycentric coordinates of the primary hit
+    Vec3 point;                 // World-space hit point
+    Vec3 normal;                // World-space shading normal
+    Vec3 albedo;
+} GBufferSample;
+
+typedef struct {
+    GBufferSample* samples;
+    int width;
+    int height;
+    size_t sample_capacity;
+    int frame;                  // Frame the samples belong to, -1 when they are stale
+} GBuffer;
+
+// G-buffer operations, storage grows with the render resolution
+GBuffer create_gbuffer(void);
+void resize_gbuffer(GBuffer* buffer, int width, int height);
+void destroy_gbuffer(GBuffer* buffer);
+
+#endif
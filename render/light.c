@@ -1,5 +1,38 @@
 #include "light.h"
+#include <math.h>
 
 DirectionalLight create_directional_light(Vec3 direction, Vec3 color) {
     return (DirectionalLight){vec3_normalize(direction), color};
-}
\ No newline at end of file
+}
+
+Light create_point_light(Vec3 position, Vec3 color) {
+    return (Light){LIGHT_POINT, position, color, {0, -1, 0}, -1.0f, -1.0f};
+}
+
+// Angles are half-angles in radians
+Light create_spot_light(Vec3 position, Vec3 direction, Vec3 color, float inner_angle, float outer_angle) {
+    return (Light){LIGHT_SPOT, position, color, vec3_normalize(direction), cosf(inner_angle), cosf(outer_angle)};
+}
+
+// Incident radiance at point, direction points towards the light
+Vec3 get_light_radiance(const Light* light, Vec3 point, Vec3* direction, float* distance) {
+    Vec3 offset = vec3_sub(light->position, point);
+    float dist = vec3_length(offset);
+    *distance = dist;
+    *direction = vec3_mul(offset, 1.0f / fmaxf(dist, 1e-6f));
+
+    float falloff = 1.0f / fmaxf(dist * dist, LIGHT_MIN_DISTANCE * LIGHT_MIN_DISTANCE);
+    if (light->type == LIGHT_SPOT) {
+        // Smooth transition between the inner and outer cone
+        float cos_angle = -vec3_dot(*direction, light->direction);
+        float t = (cos_angle - light->cos_outer) / fmaxf(light->cos_inner - light->cos_outer, 1e-6f);
+        t = fminf(fmaxf(t, 0.0f), 1.0f);
+        falloff *= t * t * (3.0f - 2.0f * t);
+    }
+    return vec3_mul(light->color, falloff);
+}
+
+// Luminance of the emitted intensity, used to weight lights against each other
+float get_light_power(const Light* light) {
+    return 0.2126f * light->color.x + 0.7152f * light->color.y + 0.0722f * light->color.z;
+}
@@ -3,12 +3,32 @@
 
 #include "math/vec3.h"
 
+#define LIGHT_MIN_DISTANCE 0.01f   // Clamps the inverse square falloff near a light
+
 typedef struct {
     Vec3 direction;
     Vec3 color;
 } DirectionalLight;
 
+typedef enum {
+    LIGHT_POINT,
+    LIGHT_SPOT
+} LightType;
+
+typedef struct {
+    LightType type;
+    Vec3 position;
+    Vec3 color;                 // Intensity, falls off with the squared distance
+    Vec3 direction;             // Spot axis
+    float cos_inner;            // Full intensity inside this cone
+    float cos_outer;            // No light outside this cone
+} Light;
+
 // Light operations
 DirectionalLight create_directional_light(Vec3 direction, Vec3 color);
+Light create_point_light(Vec3 position, Vec3 color);
+Light create_spot_light(Vec3 position, Vec3 direction, Vec3 color, float inner_angle, float outer_angle);
+Vec3 get_light_radiance(const Light* light, Vec3 point, Vec3* direction, float* distance);
+float get_light_power(const Light* light);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,114 @@
+#include "light_tree.h"
+#include <stdlib.h>
+#include <math.h>
+
+typedef struct {
+    Vec3 position;
+    float key;                  // Coordinate along the current split axis
+    int light_index;
+} LightEntry;
+
+static int compare_light_entries(const void* a, const void* b) {
+    const LightEntry* ea = (const LightEntry*)a;
+    const LightEntry* eb = (const LightEntry*)b;
+    if (ea->key != eb->key) return ea->key < eb->key ? -1 : 1;
+    return ea->light_index - eb->light_index;
+}
+
+// Median split along the longest axis, nodes are stored in depth-first order
+static int build_light_tree_node(LightTree* tree, const Light* lights, LightEntry* entries, int start, int count) {
+    int index = tree->node_count++;
+    LightTreeNode* node = &tree->nodes[index];
+    node->bounds = create_empty_aabb();
+    node->power = 0.0f;
+    node->left = node->right = -1;
+    node->light_index = -1;
+    for (int i = start; i < start + count; i++) {
+        node->bounds = expand_aabb(node->bounds, entries[i].position);
+        node->power += get_light_power(&lights[entries[i].light_index]);
+    }
+
+    if (count == 1) {
+        node->light_index = entries[start].light_index;
+        return index;
+    }
+
+    Vec3 extent = vec3_sub(node->bounds.max, node->bounds.min);
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent.x && extent.z > extent.y) axis = 2;
+    for (int i = start; i < start + count; i++) {
+        Vec3 p = entries[i].position;
+        entries[i].key = axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    }
+    qsort(&entries[start], count, sizeof(LightEntry), compare_light_entries);
+
+    int left = build_light_tree_node(tree, lights, entries, start, count / 2);
+    int right = build_light_tree_node(tree, lights, entries, start + count / 2, count - count / 2);
+    tree->nodes[index].left = left;
+    tree->nodes[index].right = right;
+    return index;
+}
+
+LightTree create_light_tree(const Light* lights, int count) {
+    LightTree tree = {NULL, 0};
+    if (count <= 0) return tree;
+
+    LightEntry* entries = (LightEntry*)malloc(count * sizeof(LightEntry));
+    for (int i = 0; i < count; i++) entries[i] = (LightEntry){lights[i].position, 0.0f, i};
+
+    tree.nodes = (LightTreeNode*)malloc((2 * count - 1) * sizeof(LightTreeNode));
+    build_light_tree_node(&tree, lights, entries, 0, count);
+    free(entries);
+    return tree;
+}
+
+// Estimated contribution of a cluster: power over squared distance, zero if it lies behind the surface
+static float get_node_importance(const LightTreeNode* node, Vec3 point, Vec3 normal) {
+    Vec3 center = vec3_mul(vec3_add(node->bounds.min, node->bounds.max), 0.5f);
+    Vec3 half_extent = vec3_mul(vec3_sub(node->bounds.max, node->bounds.min), 0.5f);
+    float radius = vec3_length(half_extent);
+    Vec3 offset = vec3_sub(center, point);
+    if (vec3_dot(offset, normal) < -radius) return 0.0f;
+
+    // Points inside a cluster see it at the distance of its radius
+    float distance_squared = fmaxf(vec3_dot(offset, offset), radius * radius);
+    distance_squared = fmaxf(distance_squared, LIGHT_MIN_DISTANCE * LIGHT_MIN_DISTANCE);
+    return node->power / distance_squared;
+}
+
+// Walk down the tree picking children by importance, u in [0, 1) is reused at every level
+bool sample_light_tree(const LightTree* tree, Vec3 point, Vec3 normal, float u,
+                       int* light_index, float* pdf) {
+    if (tree->node_count == 0) return false;
+
+    int index = 0;
+    *pdf = 1.0f;
+    while (tree->nodes[index].left >= 0) {
+        const LightTreeNode* node = &tree->nodes[index];
+        float left = get_node_importance(&tree->nodes[node->left], point, normal);
+        float right = get_node_importance(&tree->nodes[node->right], point, normal);
+        if (left + right <= 0.0f) return false;
+
+        float p_left = left / (left + right);
+        if (u < p_left) {
+            u = u / p_left;
+            *pdf *= p_left;
+            index = node->left;
+        } else {
+            u = (u - p_left) / (1.0f - p_left);
+            *pdf *= 1.0f - p_left;
+            index = node->right;
+        }
+        u = fminf(u, 0.99999994f);
+    }
+
+    *light_index = tree->nodes[index].light_index;
+    return true;
+}
+
+void destroy_light_tree(LightTree* tree) {
+    free(tree->nodes);
+    tree->nodes = NULL;
+    tree->node_count = 0;
+}
@@ -0,0 +1,27 @@
+#ifndef LIGHT_TREE_H
+#define LIGHT_TREE_H
+
+#include "render/light.h"
+#include "geometry/aabb.h"
+#include <stdbool.h>
+
+typedef struct {
+    AABB bounds;                // Positions of all lights below
+    float power;                // Summed power of all lights below
+    int left;                   // Child node indices, -1 for leaves
+    int right;
+    int light_index;            // Light of a leaf
+} LightTreeNode;
+
+typedef struct {
+    LightTreeNode* nodes;
+    int node_count;
+} LightTree;
+
+// Light hierarchy for importance sampling many lights, the root is node 0
+LightTree create_light_tree(const Light* lights, int count);
+bool sample_light_tree(const LightTree* tree, Vec3 point, Vec3 normal, float u,
+                       int* light_index, float* pdf);
+void destroy_light_tree(LightTree* tree);
+
+#endif
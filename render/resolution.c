@@ -0,0 +1,30 @@
+#include "resolution.h"
+#include <math.h>
+
+ResolutionController create_resolution_controller(float target_ms, float initial_scale,
+                                                  float min_scale, float max_scale) {
+    return (ResolutionController){
+        .target_ms = target_ms,
+        .scale = fminf(fmaxf(initial_scale, min_scale), max_scale),
+        .min_scale = min_scale,
+        .max_scale = max_scale,
+        .full_frame_ms = 0.0f
+    };
+}
+
+float update_resolution_controller(ResolutionController* controller, float frame_ms) {
+    // Render time grows with pixel count, i.e. with the square of the scale
+    float scale_sq = controller->scale * controller->scale;
+    float full_ms = frame_ms / scale_sq;
+
+    // Smooth out single slow or fast frames
+    if (controller->full_frame_ms <= 0.0f) controller->full_frame_ms = full_ms;
+    else controller->full_frame_ms = 0.7f * controller->full_frame_ms + 0.3f * full_ms;
+
+    float scale = sqrtf(controller->target_ms / fmaxf(controller->full_frame_ms, 1e-3f));
+
+    // Limit each adjustment so the controller does not oscillate
+    scale = fminf(fmaxf(scale, controller->scale * 0.8f), controller->scale * 1.25f);
+    controller->scale = fminf(fmaxf(scale, controller->min_scale), controller->max_scale);
+    return controller->scale;
+}
@@ -0,0 +1,17 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+typedef struct {
+    float target_ms;        // Frame time budget
+    float scale;            // Current render scale relative to the output size
+    float min_scale;
+    float max_scale;
+    float full_frame_ms;    // Estimated time of a frame at scale 1, 0 until the first frame
+} ResolutionController;
+
+// Resolution control
+ResolutionController create_resolution_controller(float target_ms, float initial_scale,
+                                                  float min_scale, float max_scale);
+float update_resolution_controller(ResolutionController* controller, float frame_ms);
+
+#endif
@@ -0,0 +1,226 @@
+#include "visibility.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    Vec3 position;              // Camera space: x right, y up, z along the view direction
+    Vec3 barycentrics;
+} ClipVertex;
+
+VisibilityBuffer create_visibility_buffer(int width, int height) {
+    VisibilityBuffer buffer;
+    buffer.width = width;
+    buffer.height = height;
+    buffer.sample_capacity = (size_t)width * height;
+    buffer.samples = (VisibilitySample*)malloc(buffer.sample_capacity * sizeof(VisibilitySample));
+    buffer.triangles = NULL;
+    buffer.triangle_capacity = 0;
+    buffer.forward = (Vec3){0, 0, 1};
+    return buffer;
+}
+
+static ClipVertex lerp_clip_vertex(ClipVertex a, ClipVertex b, float t) {
+    return (ClipVertex){
+        vec3_add(a.position, vec3_mul(vec3_sub(b.position, a.position), t)),
+        vec3_add(a.barycentrics, vec3_mul(vec3_sub(b.barycentrics, a.barycentrics), t))
+    };
+}
+
+// Sutherland-Hodgman against the near plane, a triangle yields at most a quad
+static int clip_near_plane(const ClipVertex* in, ClipVertex* out) {
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        ClipVertex a = in[i];
+        ClipVertex b = in[(i + 1) % 3];
+        bool a_inside = a.position.z >= VISIBILITY_NEAR_PLANE;
+        bool b_inside = b.position.z >= VISIBILITY_NEAR_PLANE;
+        if (a_inside) out[count++] = a;
+        if (a_inside != b_inside) {
+            float t = (VISIBILITY_NEAR_PLANE - a.position.z) / (b.position.z - a.position.z);
+            out[count++] = lerp_clip_vertex(a, b, t);
+        }
+    }
+    return count;
+}
+
+static void project_triangle(ProjectedTriangle* out, const ClipVertex* v, float scale_x, float scale_y,
+                             int width, int height, int mesh_index, int triangle_index) {
+    out->mesh_index = -1;
+    for (int i = 0; i < 3; i++) {
+        float inv_depth = 1.0f / v[i].position.z;
+        out->x[i] = (v[i].position.x * inv_depth * scale_x + 1.0f) * 0.5f * width;
+        out->y[i] = (1.0f - v[i].position.y * inv_depth * scale_y) * 0.5f * height;
+        out->inv_depth[i] = inv_depth;
+        out->barycentrics[i] = v[i].barycentrics;
+    }
+
+    // Skip triangles that are degenerate or entirely off screen
+    float area = (out->x[1] - out->x[0]) * (out->y[2] - out->y[0]) -
+                 (out->x[2] - out->x[0]) * (out->y[1] - out->y[0]);
+    float min_x = fminf(out->x[0], fminf(out->x[1], out->x[2]));
+    float max_x = fmaxf(out->x[0], fmaxf(out->x[1], out->x[2]));
+    out->min_y = fminf(out->y[0], fminf(out->y[1], out->y[2]));
+    out->max_y = fmaxf(out->y[0], fmaxf(out->y[1], out->y[2]));
+    if (area == 0.0f || max_x < 0.0f || min_x > width || out->max_y < 0.0f || out->min_y > height) return;
+
+    out->mesh_index = mesh_index;
+    out->triangle_index = triangle_index;
+}
+
+// Transform one triangle into camera space, clip it and fill its two output slots
+static void setup_triangle(ProjectedTriangle* slots, const Triangle* tri, const Affine3x4* model,
+                           Vec3 position, Vec3 right, Vec3 up, Vec3 forward,
+                           float scale_x, float scale_y, int width, int height,
+                           int mesh_index, int triangle_index) {
+    const Vec3 corners[3] = {tri->v0, tri->v1, tri->v2};
+    ClipVertex in[3], clipped[4];
+    for (int i = 0; i < 3; i++) {
+        Vec3 offset = vec3_sub(affine_transform_point(model, corners[i]), position);
+        in[i].position = (Vec3){vec3_dot(offset, right), vec3_dot(offset, up), vec3_dot(offset, forward)};
+        in[i].barycentrics = (Vec3){i == 0, i == 1, i == 2};
+    }
+
+    slots[0].mesh_index = slots[1].mesh_index = -1;
+    int count = clip_near_plane(in, clipped);
+    if (count < 3) return;
+    project_triangle(&slots[0], clipped, scale_x, scale_y, width, height, mesh_index, triangle_index);
+    if (count == 4) {
+        ClipVertex fan[3] = {clipped[0], clipped[2], clipped[3]};
+        project_triangle(&slots[1], fan, scale_x, scale_y, width, height, mesh_index, triangle_index);
+    }
+}
+
+// Edge-function rasterization of one triangle into the rows [band_start, band_end)
+static void rasterize_triangle(VisibilityBuffer* buffer, const ProjectedTriangle* tri, int band_start, int band_end) {
+    float x0 = tri->x[0], y0 = tri->y[0];
+    float x1 = tri->x[1], y1 = tri->y[1];
+    float x2 = tri->x[2], y2 = tri->y[2];
+    float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    float inv_area = 1.0f / area;
+
+    int min_x = (int)fmaxf(floorf(fminf(x0, fminf(x1, x2))), 0.0f);
+    int max_x = (int)fminf(ceilf(fmaxf(x0, fmaxf(x1, x2))), (float)buffer->width - 1);
+    int min_y = (int)fmaxf(floorf(tri->min_y), (float)band_start);
+    int max_y = (int)fminf(ceilf(tri->max_y), (float)band_end - 1);
+
+    for (int y = min_y; y <= max_y; y++) {
+        float py = y + 0.5f;
+        for (int x = min_x; x <= max_x; x++) {
+            float px = x + 0.5f;
+
+            // Edge functions scaled by the signed area, so either winding works
+            float w0 = ((x1 - px) * (y2 - py) - (x2 - px) * (y1 - py)) * inv_area;
+            float w1 = ((x2 - px) * (y0 - py) - (x0 - px) * (y2 - py)) * inv_area;
+            float w2 = 1.0f - w0 - w1;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+            // Perspective-correct interpolation through 1/depth
+            float p0 = w0 * tri->inv_depth[0];
+            float p1 = w1 * tri->inv_depth[1];
+            float p2 = w2 * tri->inv_depth[2];
+            float inv_depth = p0 + p1 + p2;
+            float depth = 1.0f / inv_depth;
+
+            VisibilitySample* sample = &buffer->samples[y * buffer->width + x];
+            if (depth >= sample->depth) continue;
+
+            Vec3 barycentrics = vec3_mul(vec3_add(vec3_add(
+                vec3_mul(tri->barycentrics[0], p0),
+                vec3_mul(tri->barycentrics[1], p1)),
+                vec3_mul(tri->barycentrics[2], p2)), depth);
+            sample->depth = depth;
+            sample->mesh_index = tri->mesh_index;
+            sample->triangle_index = tri->triangle_index;
+            sample->u = barycentrics.y;
+            sample->v = barycentrics.z;
+        }
+    }
+}
+
+void rasterize_visibility(VisibilityBuffer* buffer, const Mesh* meshes, size_t mesh_count,
+                          const Camera* camera, int width, int height) {
+    // Grow the buffers if the render resolution or the scene got larger
+    if ((size_t)width * height > buffer->sample_capacity) {
+        buffer->sample_capacity = (size_t)width * height;
+        buffer->samples = (VisibilitySample*)realloc(buffer->samples, buffer->sample_capacity * sizeof(VisibilitySample));
+    }
+    buffer->width = width;
+    buffer->height = height;
+
+    size_t total_triangles = 0;
+    for (size_t m = 0; m < mesh_count; m++) total_triangles += meshes[m].triangle_count;
+    if (2 * total_triangles > buffer->triangle_capacity) {
+        buffer->triangle_capacity = 2 * total_triangles;
+        buffer->triangles = (ProjectedTriangle*)realloc(buffer->triangles, buffer->triangle_capacity * sizeof(ProjectedTriangle));
+    }
+
+    // Camera basis matching get_camera_ray
+    float aspect = (float)width / height;
+    Vec3 forward = vec3_normalize(vec3_sub(camera->look_at, camera->position));
+    Vec3 right = vec3_normalize(vec3_cross(forward, camera->up));
+    Vec3 up = vec3_cross(right, forward);
+    float scale = tanf((camera->fov * 0.5f) * M_PI / 180.0f);
+    buffer->forward = forward;
+
+    // Setup writes fixed slots per triangle, so the raster order never depends on scheduling
+    size_t offset = 0;
+    for (size_t m = 0; m < mesh_count; m++) {
+        const Mesh* mesh = &meshes[m];
+        Affine3x4 model = get_mesh_object_to_world(mesh);
+        ProjectedTriangle* slots = &buffer->triangles[2 * offset];
+
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < mesh->triangle_count; i++) {
+            Triangle scratch;
+            setup_triangle(&slots[2 * i], get_mesh_triangle(mesh, i, &scratch), &model,
+                           camera->position, right, up, forward,
+                           1.0f / (aspect * scale), 1.0f / scale, width, height, (int)m, (int)i);
+        }
+        offset += mesh->triangle_count;
+    }
+
+    // Each band of rows is owned by one thread, nearest depth wins with ties going to the earlier triangle
+    int band_count = (height + VISIBILITY_BAND_HEIGHT - 1) / VISIBILITY_BAND_HEIGHT;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int band = 0; band < band_count; band++) {
+        int band_start = band * VISIBILITY_BAND_HEIGHT;
+        int band_end = band_start + VISIBILITY_BAND_HEIGHT < height ? band_start + VISIBILITY_BAND_HEIGHT : height;
+        for (int y = band_start; y < band_end; y++) {
+            for (int x = 0; x < width; x++) {
+                buffer->samples[y * width + x] = (VisibilitySample){INFINITY, -1, -1, 0.0f, 0.0f};
+            }
+        }
+        for (size_t i = 0; i < 2 * total_triangles; i++) {
+            const ProjectedTriangle* tri = &buffer->triangles[i];
+            if (tri->mesh_index < 0 || tri->max_y < band_start || tri->min_y > band_end) continue;
+            rasterize_triangle(buffer, tri, band_start, band_end);
+        }
+    }
+}
+
+bool get_visibility_hit(const VisibilityBuffer* buffer, int x, int y, Ray ray,
+                        float* t, float* u, float* v, int* mesh_index, int* triangle_index) {
+    const VisibilitySample* sample = &buffer->samples[y * buffer->width + x];
+    if (sample->mesh_index < 0) return false;
+
+    // Depth is measured along the view axis, the ray distance along the pixel's direction
+    *t = sample->depth / vec3_dot(ray.direction, buffer->forward);
+    *u = sample->u;
+    *v = sample->v;
+    *mesh_index = sample->mesh_index;
+    *triangle_index = sample->triangle_index;
+    return true;
+}
+
+void destroy_visibility_buffer(VisibilityBuffer* buffer) {
+    free(buffer->samples);
+    free(buffer->triangles);
+    buffer->samples = NULL;
+    buffer->triangles = NULL;
+    buffer->sample_capacity = 0;
+    buffer->triangle_capacity = 0;
+}
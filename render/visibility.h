@@ -0,0 +1,45 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include "geometry/mesh.h"
+#include "render/camera.h"
+#include <stdbool.h>
+
+#define VISIBILITY_BAND_HEIGHT 16
+#define VISIBILITY_NEAR_PLANE 1e-3f
+
+typedef struct {
+    float depth;                // Camera-space depth along the view direction
+    int mesh_index;             // -1 where no triangle covers the pixel
+    int triangle_index;
+    float u, v;                 // Barycentric coordinates, same convention as ray hits
+} VisibilitySample;
+
+typedef struct {
+    float x[3], y[3];           // Screen-space vertices in pixels
+    float inv_depth[3];
+    Vec3 barycentrics[3];       // Weights of the original triangle vertices, changed by clipping
+    float min_y, max_y;
+    int mesh_index;             // -1 for unused slots
+    int triangle_index;
+} ProjectedTriangle;
+
+typedef struct {
+    VisibilitySample* samples;
+    int width;
+    int height;
+    size_t sample_capacity;
+    ProjectedTriangle* triangles; // Two slots per input triangle, enough for near-plane clipping
+    size_t triangle_capacity;
+    Vec3 forward;               // Camera view direction, converts depth to ray distance
+} VisibilityBuffer;
+
+// Visibility buffer operations
+VisibilityBuffer create_visibility_buffer(int width, int height);
+void rasterize_visibility(VisibilityBuffer* buffer, const Mesh* meshes, size_t mesh_count,
+                          const Camera* camera, int width, int height);
+bool get_visibility_hit(const VisibilityBuffer* buffer, int x, int y, Ray ray,
+                        float* t, float* u, float* v, int* mesh_index, int* triangle_index);
+void destroy_visibility_buffer(VisibilityBuffer* buffer);
+
+#endif
@@ -1,7 +1,9 @@
 #include "scene.h"
-#include "accel/bvh.h"
+#include "accel/accel.h"
+#include "wavefront.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
 
@@ -11,25 +13,74 @@ Scene create_scene(int width, int height, int duration_ms, int fps, float scale_
     Scene scene;
     scene.meshes = NULL;
     scene.mesh_count = 0;
+    scene.mesh_capacity = 0;
+    scene.lights = NULL;
+    scene.light_count = 0;
+    scene.light_capacity = 0;
+    scene.light_tree = create_light_tree(NULL, 0);
+    scene.light_tree_lights = NULL;
+    scene.light_tree_light_count = 0;
     scene.width = (int)(width * scale_factor);
     scene.height = (int)(height * scale_factor);
+    scene.output_width = (int)(scene.width / scale_factor + 0.5f);
+    scene.output_height = (int)(scene.height / scale_factor + 0.5f);
     scene.scale_factor = scale_factor;
     scene.frame_count = frame_count;
     scene.current_frame = 0;
     scene.duration_ms = duration_ms;
     scene.fps = fps;
-    scene.frames = (unsigned char**)malloc(frame_count * sizeof(unsigned char*));
-    
-    // Allocate memory for each frame
+    scene.incremental = false;
+    scene.dirty = create_dirty_tracker(scene.width, scene.height);
+    scene.use_occluder_map = false;
+    scene.occluder_map = create_occluder_map(OCCLUDER_MAP_RESOLUTION);
+    scene.use_visibility_buffer = false;
+    scene.visibility_active = false;
+    scene.visibility = create_visibility_buffer(0, 0);   // Grown on first use
+    scene.use_gbuffer = false;
+    scene.gbuffer = create_gbuffer();
+    scene.dynamic_resolution = false;
+    scene.resolution = create_resolution_controller(0.0f, scale_factor, scale_factor, scale_factor);
+    reset_traversal_stats(&scene.stats);
+    scene.cost_frames = NULL;
+    scene.telemetry = NULL;
+    scene.progressive = false;
+    scene.progressive_callback = NULL;
+    scene.progressive_user_data = NULL;
+    scene.wavefront = NULL;
+    scene.numa = false;
+    memset(&scene.numa_topology, 0, sizeof(scene.numa_topology));
+    scene.numa_thread_nodes = NULL;
+    scene.numa_thread_count = 0;
+    scene.mesh_replicas = NULL;
+    scene.replica_mesh_count = 0;
+
+    // All frames share one contiguous block from the scene arena
+    scene.frame_capacity = (size_t)width * height * 3;
+    size_t frame_bytes = frame_count * scene.frame_capacity;
+    // Metadata arrays follow the pixels, each may need padding up to its alignment
+    size_t metadata_bytes = frame_count * sizeof(unsigned char*) + _Alignof(unsigned char*) - 1
+                          + 2 * (frame_count * sizeof(int) + _Alignof(int) - 1);
+    scene.arena = create_arena(frame_bytes + metadata_bytes);
+    unsigned char* frame_data = (unsigned char*)arena_alloc(&scene.arena, frame_bytes, ARENA_ALIGNMENT);
+    scene.frames = (unsigned char**)arena_alloc(&scene.arena, frame_count * sizeof(unsigned char*), _Alignof(unsigned char*));
+    scene.frame_widths = (int*)arena_alloc(&scene.arena, frame_count * sizeof(int), _Alignof(int));
+    scene.frame_heights = (int*)arena_alloc(&scene.arena, frame_count * sizeof(int), _Alignof(int));
+
     for (int i = 0; i < frame_count; i++) {
-        scene.frames[i] = (unsigned char*)malloc(width * height * 3);
+        scene.frames[i] = frame_data + i * scene.frame_capacity;
+        scene.frame_widths[i] = scene.width;
+        scene.frame_heights[i] = scene.height;
     }
     
     return scene;
 }
 
 void add_mesh_to_scene(Scene* scene, Mesh mesh) {
-    scene->meshes = (Mesh*)realloc(scene->meshes, (scene->mesh_count + 1) * sizeof(Mesh));
+    // Grow geometrically so adding n meshes costs O(log n) reallocations
+    if (scene->mesh_count == scene->mesh_capacity) {
+        scene->mesh_capacity = scene->mesh_capacity ? scene->mesh_capacity * 2 : 8;
+        scene->meshes = (Mesh*)realloc(scene->meshes, scene->mesh_capacity * sizeof(Mesh));
+    }
     scene->meshes[scene->mesh_count] = mesh;
     scene->mesh_count++;
 }
@@ -42,6 +93,214 @@ void set_scene_light(Scene* scene, Vec3 direction, Vec3 color) {
     scene->light = create_directional_light(direction, color);
 }
 
+void add_light_to_scene(Scene* scene, Light light) {
+    if (scene->light_count == scene->light_capacity) {
+        scene->light_capacity = scene->light_capacity ? scene->light_capacity * 2 : 8;
+        scene->lights = (Light*)realloc(scene->lights, scene->light_capacity * sizeof(Light));
+    }
+    scene->lights[scene->light_count++] = light;
+
+    // Lighting changed everywhere
+    invalidate_dirty_tracker(&scene->dirty);
+}
+
+bool set_scene_light_at(Scene* scene, int index, Light light) {
+    if (index < 0 || index >= scene->light_count) {
+        fprintf(stderr, "Light index %d out of range, the scene has %d lights\n", index, scene->light_count);
+        return false;
+    }
+    scene->lights[index] = light;
+    invalidate_dirty_tracker(&scene->dirty);
+    return true;
+}
+
+bool remove_light_from_scene(Scene* scene, int index) {
+    if (index < 0 || index >= scene->light_count) {
+        fprintf(stderr, "Light index %d out of range, the scene has %d lights\n", index, scene->light_count);
+        return false;
+    }
+    memmove(&scene->lights[index], &scene->lights[index + 1], (scene->light_count - index - 1) * sizeof(Light));
+    scene->light_count--;
+    invalidate_dirty_tracker(&scene->dirty);
+    return true;
+}
+
+void set_scene_incremental(Scene* scene, bool enabled) {
+    scene->incremental = enabled;
+    invalidate_dirty_tracker(&scene->dirty);
+}
+
+void set_scene_occluder_map(Scene* scene, bool enabled) {
+    scene->use_occluder_map = enabled;
+}
+
+void set_scene_visibility_buffer(Scene* scene, bool enabled) {
+    scene->use_visibility_buffer = enabled;
+}
+
+void set_scene_gbuffer(Scene* scene, bool enabled) {
+    scene->use_gbuffer = enabled;
+    scene->gbuffer.frame = -1;
+}
+
+void set_scene_dynamic_resolution(Scene* scene, float target_ms, float min_scale) {
+    scene->dynamic_resolution = target_ms > 0.0f;
+    if (scene->dynamic_resolution) {
+        // The configured scale factor is the quality ceiling
+        scene->resolution = create_resolution_controller(target_ms, scene->scale_factor,
+                                                         fminf(min_scale, scene->scale_factor),
+                                                         scene->scale_factor);
+    } else {
+        scene->width = (int)(scene->output_width * scene->scale_factor);
+        scene->height = (int)(scene->output_height * scene->scale_factor);
+    }
+}
+
+void set_scene_heatmap(Scene* scene, bool enabled) {
+    if (enabled && !scene->cost_frames) {
+        int width = scene->width > scene->output_width ? scene->width : scene->output_width;
+        int height = scene->height > scene->output_height ? scene->height : scene->output_height;
+        scene->cost_frames = (uint16_t**)malloc(scene->frame_count * sizeof(uint16_t*));
+        for (int i = 0; i < scene->frame_count; i++) {
+            scene->cost_frames[i] = (uint16_t*)calloc(width * height, sizeof(uint16_t));
+        }
+    } else if (!enabled && scene->cost_frames) {
+        for (int i = 0; i < scene->frame_count; i++) {
+            free(scene->cost_frames[i]);
+        }
+        free(scene->cost_frames);
+        scene->cost_frames = NULL;
+    }
+}
+
+void set_scene_telemetry(Scene* scene, Telemetry* telemetry) {
+    scene->telemetry = telemetry;
+}
+
+void set_scene_wavefront(Scene* scene, struct Wavefront* wavefront) {
+    scene->wavefront = wavefront;
+}
+
+static void release_mesh_replicas(Scene* scene) {
+    if (scene->mesh_replicas) {
+        for (int n = 0; n < scene->numa_topology.node_count; n++) {
+            if (!scene->mesh_replicas[n]) continue;
+            for (size_t m = 0; m < scene->replica_mesh_count; m++) destroy_mesh(&scene->mesh_replicas[n][m]);
+            free(scene->mesh_replicas[n]);
+        }
+        free(scene->mesh_replicas);
+    }
+    scene->mesh_replicas = NULL;
+    scene->replica_mesh_count = 0;
+}
+
+void set_scene_numa(Scene* scene, bool enabled) {
+    release_mesh_replicas(scene);
+    destroy_numa_topology(&scene->numa_topology);
+    free(scene->numa_thread_nodes);
+    scene->numa_thread_nodes = NULL;
+    scene->numa_thread_count = 0;
+    scene->numa = enabled;
+    if (!enabled) return;
+
+    scene->numa_topology = get_numa_topology();
+    int threads = omp_get_max_threads();
+    scene->numa_thread_count = threads;
+    scene->numa_thread_nodes = (int*)malloc(threads * sizeof(int));
+
+    // OpenMP keeps reusing the same pool, so threads stay pinned for every later region
+    bool pinned = true;
+    #pragma omp parallel num_threads(threads) reduction(&&:pinned)
+    {
+        int thread = omp_get_thread_num();
+        scene->numa_thread_nodes[thread] = get_numa_thread_node(&scene->numa_topology, thread, threads);
+        pinned = pin_numa_thread(&scene->numa_topology, thread, threads);
+    }
+    if (!pinned) fprintf(stderr, "Could not pin every render thread, continuing unpinned\n");
+
+    // First touch the frames one tile row at a time, so every node holds a share of each frame
+    int tile_rows = (scene->height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    size_t row_bytes = (size_t)scene->width * 3 * DIRTY_TILE_SIZE;
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int i = 0; i < scene->frame_count * tile_rows; i++) {
+        size_t offset = (size_t)(i % tile_rows) * row_bytes;
+        if (offset >= scene->frame_capacity) continue;
+        size_t size = scene->frame_capacity - offset < row_bytes ? scene->frame_capacity - offset : row_bytes;
+        memset(scene->frames[i / tile_rows] + offset, 0, size);
+    }
+}
+
+// Node-local meshes for the calling render thread
+Mesh* get_thread_meshes(const Scene* scene) {
+    if (!scene->mesh_replicas) return scene->meshes;
+    int thread = omp_get_thread_num();
+    int node = thread < scene->numa_thread_count ? scene->numa_thread_nodes[thread] : 0;
+    return scene->mesh_replicas[node] ? scene->mesh_replicas[node] : scene->meshes;
+}
+
+// Refresh the matrices of meshes whose transform was written directly, e.g. by an animation callback
+static void update_scene_transforms(Scene* scene) {
+    for (size_t m = 0; m < scene->mesh_count; m++) update_mesh_transform(&scene->meshes[m]);
+}
+
+static bool has_paged_meshes(const Scene* scene) {
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        if (scene->meshes[m].accel.type == ACCEL_PAGED) return true;
+    }
+    return false;
+}
+
+// Finish every pending lazy split, in the scene meshes and all of their node replicas
+static void complete_scene_accels(Scene* scene) {
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        complete_accel(&scene->meshes[m].accel);
+        for (int n = 0; scene->mesh_replicas && n < scene->numa_topology.node_count; n++) {
+            if (scene->mesh_replicas[n]) complete_accel(&scene->mesh_replicas[n][m].accel);
+        }
+    }
+}
+
+// Copy the meshes once per node from a thread of that node, then keep the copies' transforms current
+static void update_mesh_replicas(Scene* scene) {
+    if (!scene->numa || scene->numa_topology.node_count < 2) return;
+
+    if (scene->replica_mesh_count != scene->mesh_count) {
+        release_mesh_replicas(scene);
+        scene->mesh_replicas = (Mesh**)calloc(scene->numa_topology.node_count, sizeof(Mesh*));
+        #pragma omp parallel num_threads(scene->numa_thread_count)
+        {
+            int thread = omp_get_thread_num();
+            int node = scene->numa_thread_nodes[thread];
+            if (thread == 0 || scene->numa_thread_nodes[thread - 1] != node) {
+                Mesh* replicas = (Mesh*)malloc(scene->mesh_count * sizeof(Mesh));
+                for (size_t m = 0; m < scene->mesh_count; m++) replicas[m] = copy_mesh(&scene->meshes[m]);
+                scene->mesh_replicas[node] = replicas;
+            }
+        }
+        scene->replica_mesh_count = scene->mesh_count;
+    }
+
+    for (int n = 0; n < scene->numa_topology.node_count; n++) {
+        if (!scene->mesh_replicas[n]) continue;
+        for (size_t m = 0; m < scene->mesh_count; m++) {
+            scene->mesh_replicas[n][m].transform = scene->meshes[m].transform;
+            update_mesh_transform(&scene->mesh_replicas[n][m]);
+        }
+    }
+}
+
+void set_scene_progressive(Scene* scene, bool enabled, ProgressiveCallback callback, void* user_data) {
+    scene->progressive = enabled;
+    scene->progressive_callback = callback;
+    scene->progressive_user_data = user_data;
+}
+
+void set_scene_frame(Scene* scene, int frame) {
+    if (frame < 0) frame = 0;
+    if (frame >= scene->frame_count) frame = scene->frame_count - 1;
+    scene->current_frame = frame;
+}
+
 void next_frame(Scene* scene) {
     scene->current_frame++;
     if (scene->current_frame >= scene->frame_count) {
@@ -49,120 +308,714 @@ void next_frame(Scene* scene) {
     }
 }
 
-void render_scene(Scene* scene) {
-    float aspect = (float)scene->width / scene->height;
-    unsigned char* current_frame = scene->frames[scene->current_frame];
+static bool mesh_occludes(const Mesh* mesh, Ray shadow_ray, float max_distance) {
+    // Transform shadow ray to mesh local space
+    Affine3x4 world_to_object = get_mesh_world_to_object(mesh);
+    Ray transformed_shadow_ray = affine_transform_ray(shadow_ray, &world_to_object);
+    
+    return occluded_accel(&mesh->accel, transformed_shadow_ray, max_distance);
+}
 
-    // Parallelize the outer loop (rows)
-    #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < scene->height; y++) {
-        for (int x = 0; x < scene->width; x++) {
-            Ray ray = get_camera_ray(&scene->camera, 
-                                   (x + 0.5f) / scene->width, 
-                                   (y + 0.5f) / scene->height, 
-                                   aspect);
-            
-            float closest_t = 1e30f;
-            bool hit = false;
-            Vec2 hit_uv = {0, 0};
-            Vec3 hit_normal = {0, 0, 0};
-            const Mesh* hit_mesh = NULL;
-
-            // Check intersection with all meshes using BVH
-            for (size_t m = 0; m < scene->mesh_count; m++) {
-                const Mesh* current_mesh = &scene->meshes[m];
-                float t = closest_t;
-                float u, v;
-                int tri_idx;
-                
-                // Transform ray to mesh local space
-                Ray transformed_ray = transform_ray(ray, current_mesh->transform);
-                
-                if (intersect_bvh(current_mesh->bvh.root, transformed_ray, current_mesh->triangles,
-                                 &t, &u, &v, &tri_idx) && t < closest_t) {
-                    closest_t = t;
-                    hit = true;
-                    hit_mesh = current_mesh;
-                    float w = 1.0f - u - v;
-
-                    // Interpolate texture coordinates
-                    hit_uv.u = w * current_mesh->triangles[tri_idx].t0.u + 
-                              u * current_mesh->triangles[tri_idx].t1.u + 
-                              v * current_mesh->triangles[tri_idx].t2.u;
-                    hit_uv.v = w * current_mesh->triangles[tri_idx].t0.v + 
-                              u * current_mesh->triangles[tri_idx].t1.v + 
-                              v * current_mesh->triangles[tri_idx].t2.v;
-
-                    // Interpolate normal
-                    hit_normal = vec3_normalize(vec3_add(
-                        vec3_add(
-                            vec3_mul(current_mesh->triangles[tri_idx].n0, w),
-                            vec3_mul(current_mesh->triangles[tri_idx].n1, u)
-                        ),
-                        vec3_mul(current_mesh->triangles[tri_idx].n2, v)
-                    ));
-
-                    // Transform the interpolated normal according to the mesh's transformation
-                    hit_normal = transform_normal(hit_normal, hit_mesh->transform);
+bool intersect_scene(const Scene* scene, Ray ray, SceneHit* hit) {
+    bool found = false;
+    STATS_INC(rays);
+    hit->t = 1e30f;
+    hit->u = hit->v = 0.0f;
+    hit->mesh_index = -1;
+    hit->triangle_index = -1;
+
+    // Check intersection with all meshes using their acceleration structures
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        const Mesh* current_mesh = &scene->meshes[m];
+        float t = hit->t;
+        float u, v;
+        int tri_idx;
+        
+        // Transform ray to mesh local space
+        Affine3x4 world_to_object = get_mesh_world_to_object(current_mesh);
+        Ray transformed_ray = affine_transform_ray(ray, &world_to_object);
+        
+        if (intersect_accel(&current_mesh->accel, transformed_ray,
+                            &t, &u, &v, &tri_idx) && t < hit->t) {
+            hit->t = t;
+            hit->u = u;
+            hit->v = v;
+            hit->mesh_index = (int)m;
+            hit->triangle_index = tri_idx;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool occluded_scene(const Scene* scene, Ray shadow_ray) {
+    STATS_INC(rays);
+    if (scene->use_occluder_map) {
+        // Only meshes covering this light-space cell and lying towards the light can occlude
+        OccluderCell cell = find_occluder_cell(&scene->occluder_map, shadow_ray.origin);
+        for (int i = 0; i < cell.count; i++) {
+            if (cell.depths[i] > cell.depth &&
+                mesh_occludes(&scene->meshes[cell.meshes[i]], shadow_ray, 1e30f)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        if (mesh_occludes(&scene->meshes[m], shadow_ray, 1e30f)) return true;
+    }
+    return false;
+}
+
+// Shadow test for lights at a finite distance, the occluder map only covers the directional light
+bool occluded_scene_within(const Scene* scene, Ray shadow_ray, float max_distance) {
+    STATS_INC(rays);
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        if (mesh_occludes(&scene->meshes[m], shadow_ray, max_distance)) return true;
+    }
+    return false;
+}
+
+// Hash of pixel and sample index, noise stays fixed from frame to frame
+static float get_pixel_random(int x, int y, int sample) {
+    uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u ^ (uint32_t)sample * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return (h >> 8) / 16777216.0f;
+}
+
+// Light tree samples with a positive contribution, a fixed number of draws per point
+int sample_scene_local_lights(const Scene* scene, const SurfaceSample* surface, int x, int y,
+                              LocalLightSample samples[LIGHT_SAMPLE_COUNT]) {
+    int count = 0;
+    for (int s = 0; s < LIGHT_SAMPLE_COUNT; s++) {
+        int light_index;
+        float pdf;
+        if (!sample_light_tree(&scene->light_tree, surface->point, surface->normal, get_pixel_random(x, y, s),
+                               &light_index, &pdf)) {
+            continue;
+        }
+
+        Vec3 direction;
+        float distance;
+        Vec3 incident = get_light_radiance(&scene->lights[light_index], surface->point, &direction, &distance);
+        float cos_theta = vec3_dot(surface->normal, direction);
+        if (cos_theta <= 0.0f) continue;
+
+        samples[count].shadow_ray = (Ray){surface->shadow_origin, direction};
+        samples[count].distance = distance;
+        samples[count].radiance = vec3_mul(incident, cos_theta / (pdf * LIGHT_SAMPLE_COUNT));
+        count++;
+    }
+    return count;
+}
+
+// Stochastic estimate of the point and spot lights
+static Vec3 shade_local_lights(const Scene* scene, const SurfaceSample* surface, int x, int y) {
+    LocalLightSample samples[LIGHT_SAMPLE_COUNT];
+    int count = sample_scene_local_lights(scene, surface, x, y, samples);
+    Vec3 radiance = {0, 0, 0};
+    for (int s = 0; s < count; s++) {
+        if (occluded_scene_within(scene, samples[s].shadow_ray, samples[s].distance)) continue;
+        radiance = vec3_add(radiance, samples[s].radiance);
+    }
+    return radiance;
+}
+
+bool get_scene_primary_hit(const Scene* scene, int x, int y, Ray ray, SceneHit* hit) {
+    if (scene->visibility_active) {
+        return get_visibility_hit(&scene->visibility, x, y, ray, &hit->t, &hit->u, &hit->v,
+                                  &hit->mesh_index, &hit->triangle_index);
+    }
+    return intersect_scene(scene, ray, hit);
+}
+
+SurfaceSample get_scene_surface(const Scene* scene, Ray ray, const SceneHit* hit) {
+    const Mesh* hit_mesh = &scene->meshes[hit->mesh_index];
+    Triangle scratch;
+    const Triangle* tri = get_mesh_triangle(hit_mesh, hit->triangle_index, &scratch);
+    float u = hit->u, v = hit->v;
+    float w = 1.0f - u - v;
+    SurfaceSample surface;
+
+    // Interpolate texture coordinates
+    Vec2 hit_uv;
+    hit_uv.u = w * tri->t0.u + u * tri->t1.u + v * tri->t2.u;
+    hit_uv.v = w * tri->t0.v + u * tri->t1.v + v * tri->t2.v;
+
+    // Interpolate normal
+    Vec3 hit_normal = vec3_normalize(vec3_add(
+        vec3_add(
+            vec3_mul(tri->n0, w),
+            vec3_mul(tri->n1, u)
+        ),
+        vec3_mul(tri->n2, v)
+    ));
+
+    // Transform the interpolated normal according to the mesh's transformation
+    Affine3x4 object_to_world = get_mesh_object_to_world(hit_mesh);
+    surface.normal = vec3_normalize(affine_transform_vector(&object_to_world, hit_normal));
+    surface.albedo = sample_mesh_texture(hit_mesh, hit_uv.u, hit_uv.v);
+
+    // Calculate hit point in world space using original ray
+    surface.point = vec3_add(ray.origin, vec3_mul(ray.direction, hit->t));
+    surface.shadow_origin = vec3_add(surface.point, vec3_mul(surface.normal, 0.001f));
+    return surface;
+}
+
+Vec3 get_scene_lit_radiance(const Scene* scene, const SurfaceSample* surface, bool in_shadow, Vec3 local_radiance) {
+    // Calculate diffuse lighting
+    float diffuse = 0.2f;  // Ambient light level
+
+    // Add direct lighting if not in shadow
+    if (!in_shadow) {
+        diffuse = fmaxf(diffuse, 
+            vec3_dot(surface->normal, scene->light.direction));
+    }
+
+    // Apply lighting
+    Vec3 color = vec3_mul_vec3(surface->albedo, scene->light.color);
+    color = vec3_mul(color, diffuse);
+    if (scene->light_count > 0) {
+        color = vec3_add(color, vec3_mul_vec3(surface->albedo, local_radiance));
+    }
+    return color;
+}
+
+Vec3 get_scene_radiance(const Scene* scene, const SurfaceSample* surface, bool in_shadow, int x, int y) {
+    Vec3 local = {0, 0, 0};
+    if (scene->light_count > 0) local = shade_local_lights(scene, surface, x, y);
+    return get_scene_lit_radiance(scene, surface, in_shadow, local);
+}
+
+void store_scene_pixel(unsigned char* frame, int idx, Vec3 color) {
+    // Convert to RGB bytes
+    frame[idx] = (unsigned char)(fminf(color.x * 255.0f, 255.0f));
+    frame[idx + 1] = (unsigned char)(fminf(color.y * 255.0f, 255.0f));
+    frame[idx + 2] = (unsigned char)(fminf(color.z * 255.0f, 255.0f));
+}
+
+static void render_pixel(const Scene* scene, int x, int y, float aspect, unsigned char* current_frame) {
+    Ray ray = get_camera_ray(&scene->camera, 
+                           (x + 0.5f) / scene->width, 
+                           (y + 0.5f) / scene->height, 
+                           aspect);
+    
+    SceneHit hit;
+    int idx = (y * scene->width + x) * 3;
+    GBufferSample* sample = scene->use_gbuffer ? &scene->gbuffer.samples[y * scene->width + x] : NULL;
+    if (get_scene_primary_hit(scene, x, y, ray, &hit)) {
+        SurfaceSample surface = get_scene_surface(scene, ray, &hit);
+        if (sample) {
+            *sample = (GBufferSample){hit.mesh_index, hit.triangle_index, hit.u, hit.v,
+                                      surface.point, surface.normal, surface.albedo};
+        }
+
+        // Check if point is in shadow
+        Ray shadow_ray = {surface.shadow_origin, scene->light.direction};
+        bool in_shadow = occluded_scene(scene, shadow_ray);
+
+        store_scene_pixel(current_frame, idx, get_scene_radiance(scene, &surface, in_shadow, x, y));
+    } else {
+        if (sample) sample->mesh_index = -1;
+        current_frame[idx] = current_frame[idx + 1] = current_frame[idx + 2] = SCENE_BACKGROUND;
+    }
+}
+
+// Rebuild when lights were added, removed or edited through scene->lights since the last build
+static void update_scene_light_tree(Scene* scene) {
+    bool changed = scene->light_tree_light_count != scene->light_count ||
+                   (scene->light_count > 0 &&
+                    memcmp(scene->light_tree_lights, scene->lights, scene->light_count * sizeof(Light)) != 0);
+    if (!changed) return;
+
+    destroy_light_tree(&scene->light_tree);
+    scene->light_tree = create_light_tree(scene->lights, scene->light_count);
+    scene->light_tree_lights = (Light*)realloc(scene->light_tree_lights, scene->light_count * sizeof(Light));
+    if (scene->light_count > 0) memcpy(scene->light_tree_lights, scene->lights, scene->light_count * sizeof(Light));
+    scene->light_tree_light_count = scene->light_count;
+}
+
+// Bin mesh bounds along the light for this frame's shadow rays
+static void update_scene_occluders(Scene* scene) {
+    if (scene->use_occluder_map) {
+        double start_time = get_time_seconds();
+        AABB* bounds = (AABB*)malloc(scene->mesh_count * sizeof(AABB));
+        for (size_t m = 0; m < scene->mesh_count; m++) {
+            bounds[m] = get_mesh_world_bounds(&scene->meshes[m], scene->meshes[m].transform);
+        }
+        build_occluder_map(&scene->occluder_map, scene->light.direction, bounds, scene->mesh_count);
+        free(bounds);
+        if (scene->telemetry) {
+            record_telemetry_event(scene->telemetry, STAGE_OCCLUDER_MAP, scene->current_frame, 0,
+                                   start_time, get_time_seconds());
+        }
+    }
+}
+
+void update_scene_acceleration(Scene* scene) {
+    update_scene_light_tree(scene);
+    update_scene_transforms(scene);
+    update_mesh_replicas(scene);
+    update_scene_occluders(scene);
+
+    // Resolve primary hits for the whole frame by rasterization. Rasterizing reads every triangle,
+    // which would stream paged geometry through its cache each frame, so those scenes trace instead.
+    scene->visibility_active = scene->use_visibility_buffer && !has_paged_meshes(scene);
+    if (scene->visibility_active) {
+        double start_time = get_time_seconds();
+
+        // Raster triangle indices must not be reordered by a lazy split later in the frame
+        complete_scene_accels(scene);
+        rasterize_visibility(&scene->visibility, scene->meshes, scene->mesh_count,
+                             &scene->camera, scene->width, scene->height);
+        if (scene->telemetry) {
+            record_telemetry_event(scene->telemetry, STAGE_VISIBILITY, scene->current_frame, 0,
+                                   start_time, get_time_seconds());
+        }
+    }
+}
+
+// Pick the next frame's resolution from the frame time controller
+static void apply_scene_resolution(Scene* scene) {
+    if (scene->dynamic_resolution) {
+        scene->width = (int)(scene->output_width * scene->resolution.scale);
+        scene->height = (int)(scene->output_height * scene->resolution.scale);
+        if (scene->width < 2) scene->width = 2;
+        if (scene->height < 2) scene->height = 2;
+    }
+}
+
+// Trace every dirty tile in one pass, clean tiles are copied from the previous frame
+static void render_tiles(Scene* scene, float aspect, unsigned char* current_frame,
+                         const unsigned char* previous_frame) {
+    int tiles_x = (scene->width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    int tiles_y = (scene->height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+
+#ifdef RAYTRACER_STATS
+    uint16_t* cost_frame = scene->cost_frames ? scene->cost_frames[scene->current_frame] : NULL;
+    if (cost_frame) memset(cost_frame, 0, scene->width * scene->height * sizeof(uint16_t));
+#endif
+
+    // Parallelize over screen tiles
+    #pragma omp parallel
+    {
+#ifdef RAYTRACER_STATS
+        reset_traversal_stats(&thread_traversal_stats);
+#endif
+        double busy_start = get_time_seconds();
+
+        // Trace against this thread's node-local copy of the meshes
+        Scene local = *scene;
+        local.meshes = get_thread_meshes(scene);
+
+        #pragma omp for schedule(dynamic, 1) nowait
+        for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+            int tile_x = tile % tiles_x;
+            int tile_y = tile / tiles_x;
+            int x0 = tile_x * DIRTY_TILE_SIZE;
+            int y0 = tile_y * DIRTY_TILE_SIZE;
+            int x1 = x0 + DIRTY_TILE_SIZE < scene->width ? x0 + DIRTY_TILE_SIZE : scene->width;
+            int y1 = y0 + DIRTY_TILE_SIZE < scene->height ? y0 + DIRTY_TILE_SIZE : scene->height;
+
+            if (previous_frame && !is_tile_dirty(&scene->dirty, tile_x, tile_y)) {
+                // Unchanged tile, reuse the previous frame's pixels
+                if (previous_frame != current_frame) {
+                    for (int y = y0; y < y1; y++) {
+                        int idx = (y * scene->width + x0) * 3;
+                        memcpy(&current_frame[idx], &previous_frame[idx], (x1 - x0) * 3);
+                    }
                 }
+                continue;
             }
 
-            int idx = (y * scene->width + x) * 3;
-            if (hit && hit_mesh) {
-                Vec3 color = sample_mesh_texture(hit_mesh, hit_uv.u, hit_uv.v);
-                
-                // Calculate diffuse lighting
-                float diffuse = 0.2f;  // Ambient light level
-                
-                // Calculate hit point in world space using original ray
-                Vec3 hit_point = vec3_add(ray.origin, vec3_mul(ray.direction, closest_t));
-                Vec3 shadow_origin = vec3_add(hit_point, vec3_mul(hit_normal, 0.001f));
-                Ray shadow_ray = {shadow_origin, scene->light.direction};
-                
-                // Check if point is in shadow
-                bool in_shadow = false;
-                for (size_t m = 0; m < scene->mesh_count && !in_shadow; m++) {
-                    const Mesh* current_mesh = &scene->meshes[m];
-                    float shadow_t = 1e30f;
-                    float shadow_u, shadow_v;
-                    int shadow_tri_idx;
-                    
-                    // Transform shadow ray to mesh local space
-                    Ray transformed_shadow_ray = transform_ray(shadow_ray, current_mesh->transform);
-                    
-                    if (intersect_bvh(current_mesh->bvh.root, transformed_shadow_ray, 
-                                    current_mesh->triangles,
-                                    &shadow_t, &shadow_u, &shadow_v, 
-                                    &shadow_tri_idx)) {
-                        in_shadow = true;
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+#ifdef RAYTRACER_STATS
+                    uint64_t cost = get_traversal_cost(&thread_traversal_stats);
+                    render_pixel(&local, x, y, aspect, current_frame);
+                    if (cost_frame) {
+                        cost = get_traversal_cost(&thread_traversal_stats) - cost;
+                        cost_frame[y * scene->width + x] = cost > 65535 ? 65535 : (uint16_t)cost;
                     }
+#else
+                    render_pixel(&local, x, y, aspect, current_frame);
+#endif
+                }
+            }
+        }
+
+#ifdef RAYTRACER_STATS
+        // Counters are thread local, fold them in once per thread
+        #pragma omp critical
+        merge_traversal_stats(&scene->stats, &thread_traversal_stats);
+#endif
+
+        // Time spent on tiles versus waiting for the slowest thread
+        double busy_end = get_time_seconds();
+        #pragma omp barrier
+        if (scene->telemetry) {
+            int thread = omp_get_thread_num() + 1;
+            record_telemetry_event(scene->telemetry, STAGE_BUSY, scene->current_frame, thread,
+                                   busy_start, busy_end);
+            record_telemetry_event(scene->telemetry, STAGE_IDLE, scene->current_frame, thread,
+                                   busy_end, get_time_seconds());
+        }
+    }
+}
+
+// Coarse-to-fine passes over the dirty tiles, every pass fills the blocks it leaves out
+static void render_progressive_passes(Scene* scene, float aspect, unsigned char* current_frame,
+                                      const unsigned char* previous_frame) {
+    int width = scene->width;
+    int height = scene->height;
+
+    // Unchanged tiles are final right away
+    if (previous_frame && previous_frame != current_frame) {
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < height; y++) {
+            for (int tile_x = 0; tile_x * DIRTY_TILE_SIZE < width; tile_x++) {
+                if (is_tile_dirty(&scene->dirty, tile_x, y / DIRTY_TILE_SIZE)) continue;
+                int x0 = tile_x * DIRTY_TILE_SIZE;
+                int x1 = x0 + DIRTY_TILE_SIZE < width ? x0 + DIRTY_TILE_SIZE : width;
+                int idx = (y * width + x0) * 3;
+                memcpy(&current_frame[idx], &previous_frame[idx], (x1 - x0) * 3);
+            }
+        }
+    }
+
+    int pass = 0;
+    for (int step = PROGRESSIVE_FIRST_STEP; step >= 1; step /= 2, pass++) {
+        #pragma omp parallel
+        {
+#ifdef RAYTRACER_STATS
+            reset_traversal_stats(&thread_traversal_stats);
+#endif
+            Scene local = *scene;
+            local.meshes = get_thread_meshes(scene);
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int y = 0; y < height; y += step) {
+                for (int x = 0; x < width; x += step) {
+                    if (previous_frame && !is_tile_dirty(&scene->dirty, x / DIRTY_TILE_SIZE, y / DIRTY_TILE_SIZE)) continue;
+
+                    // Pixels on the coarser grid were traced by an earlier pass
+                    if (step < PROGRESSIVE_FIRST_STEP && x % (2 * step) == 0 && y % (2 * step) == 0) continue;
+                    render_pixel(&local, x, y, aspect, current_frame);
                 }
-                
-                // Add direct lighting if not in shadow
-                if (!in_shadow) {
-                    diffuse = fmaxf(diffuse, 
-                        vec3_dot(hit_normal, scene->light.direction));
+            }
+#ifdef RAYTRACER_STATS
+            #pragma omp critical
+            merge_traversal_stats(&scene->stats, &thread_traversal_stats);
+#endif
+        }
+
+        // Blocks never straddle tiles, the step divides the tile size
+        if (step > 1) {
+            #pragma omp parallel for schedule(static)
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    if (x % step == 0 && y % step == 0) continue;
+                    if (previous_frame && !is_tile_dirty(&scene->dirty, x / DIRTY_TILE_SIZE, y / DIRTY_TILE_SIZE)) continue;
+                    int anchor = ((y - y % step) * width + (x - x % step)) * 3;
+                    int idx = (y * width + x) * 3;
+                    current_frame[idx] = current_frame[anchor];
+                    current_frame[idx + 1] = current_frame[anchor + 1];
+                    current_frame[idx + 2] = current_frame[anchor + 2];
                 }
-                
-                // Apply lighting
-                color = vec3_mul_vec3(color, scene->light.color);
-                color = vec3_mul(color, diffuse);
-                
-                // Convert to RGB bytes
-                current_frame[idx] = (unsigned char)(fminf(color.x * 255.0f, 255.0f));
-                current_frame[idx + 1] = (unsigned char)(fminf(color.y * 255.0f, 255.0f));
-                current_frame[idx + 2] = (unsigned char)(fminf(color.z * 255.0f, 255.0f));
-            } else {
-                current_frame[idx] = current_frame[idx + 1] = current_frame[idx + 2] = 50;
             }
         }
+
+        if (scene->progressive_callback) {
+            scene->progressive_callback(scene, pass, step, scene->progressive_user_data);
+        }
+    }
+}
+
+void render_scene(Scene* scene) {
+    double start_time = get_time_seconds();
+    apply_scene_resolution(scene);
+    scene->frame_widths[scene->current_frame] = scene->width;
+    scene->frame_heights[scene->current_frame] = scene->height;
+
+    float aspect = (float)scene->width / scene->height;
+    unsigned char* current_frame = scene->frames[scene->current_frame];
+
+    // Find tiles touched by moving meshes, everything else is copied from the last frame
+    const unsigned char* previous_frame = NULL;
+    if (scene->incremental) {
+        int last_frame = scene->dirty.last_frame;
+        if (update_dirty_tracker(&scene->dirty, scene->meshes, scene->mesh_count,
+                                 &scene->camera, &scene->light, scene->lights, scene->light_count,
+                                 scene->current_frame,
+                                 scene->width, scene->height)) {
+            previous_frame = scene->frames[last_frame];
+        }
+
+        // Copied tiles also keep their G-buffer samples, which must come from that same frame
+        if (scene->use_gbuffer && scene->gbuffer.frame != last_frame) previous_frame = NULL;
+    }
+
+    if (scene->use_gbuffer) {
+        resize_gbuffer(&scene->gbuffer, scene->width, scene->height);
+        scene->gbuffer.frame = scene->current_frame;
+    }
+
+    update_scene_acceleration(scene);
+
+    if (scene->progressive) {
+        render_progressive_passes(scene, aspect, current_frame, previous_frame);
+    } else if (scene->wavefront && !scene->cost_frames && !scene->use_gbuffer) {
+        // Stage-by-stage queues, heatmaps and the G-buffer need the per-pixel loop
+        render_wavefront(scene, aspect, current_frame, previous_frame);
+    } else {
+        render_tiles(scene, aspect, current_frame, previous_frame);
+    }
+
+    double end_time = get_time_seconds();
+    if (scene->dynamic_resolution) {
+        update_resolution_controller(&scene->resolution, (float)((end_time - start_time) * 1000.0));
+    }
+    if (scene->telemetry) {
+        record_telemetry_event(scene->telemetry, STAGE_RENDER, scene->current_frame, 0,
+                               start_time, end_time);
+    }
+}
+
+// Shade the current frame again from its G-buffer, only shadow rays are traced
+bool relight_scene(Scene* scene) {
+    if (!scene->use_gbuffer || scene->gbuffer.frame != scene->current_frame ||
+        scene->gbuffer.width != scene->width || scene->gbuffer.height != scene->height) {
+        fprintf(stderr, "No G-buffer for frame %d, render it with the G-buffer enabled first\n",
+                scene->current_frame);
+        return false;
+    }
+
+    double start_time = get_time_seconds();
+    update_scene_light_tree(scene);
+    update_scene_transforms(scene);
+    update_mesh_replicas(scene);
+    update_scene_occluders(scene);
+
+    unsigned char* current_frame = scene->frames[scene->current_frame];
+    int width = scene->width;
+    int pixel_count = width * scene->height;
+
+    #pragma omp parallel
+    {
+#ifdef RAYTRACER_STATS
+        reset_traversal_stats(&thread_traversal_stats);
+#endif
+        Scene local = *scene;
+        local.meshes = get_thread_meshes(scene);
+
+        #pragma omp for schedule(dynamic, 256)
+        for (int i = 0; i < pixel_count; i++) {
+            const GBufferSample* sample = &scene->gbuffer.samples[i];
+            int idx = i * 3;
+            if (sample->mesh_index < 0) {
+                current_frame[idx] = current_frame[idx + 1] = current_frame[idx + 2] = SCENE_BACKGROUND;
+                continue;
+            }
+
+            SurfaceSample surface;
+            surface.albedo = sample->albedo;
+            surface.normal = sample->normal;
+            surface.point = sample->point;
+            surface.shadow_origin = vec3_add(surface.point, vec3_mul(surface.normal, 0.001f));
+
+            Ray shadow_ray = {surface.shadow_origin, scene->light.direction};
+            bool in_shadow = occluded_scene(&local, shadow_ray);
+            store_scene_pixel(current_frame, idx, get_scene_radiance(&local, &surface, in_shadow, i % width, i / width));
+        }
+
+#ifdef RAYTRACER_STATS
+        #pragma omp critical
+        merge_traversal_stats(&scene->stats, &thread_traversal_stats);
+#endif
+    }
+
+    if (scene->telemetry) {
+        record_telemetry_event(scene->telemetry, STAGE_RENDER, scene->current_frame, 0,
+                               start_time, get_time_seconds());
+    }
+    return true;
+}
+
+void capture_frame_state(const Scene* scene, int frame, FrameState* state) {
+    if (state->mesh_count != scene->mesh_count) {
+        state->transforms = (Transform*)realloc(state->transforms, scene->mesh_count * sizeof(Transform));
+        state->mesh_count = scene->mesh_count;
+    }
+    state->frame = frame;
+    state->camera = scene->camera;
+    state->light = scene->light;
+    for (size_t m = 0; m < scene->mesh_count; m++) {
+        state->transforms[m] = scene->meshes[m].transform;
+    }
+}
+
+void destroy_frame_state(FrameState* state) {
+    free(state->transforms);
+    state->transforms = NULL;
+    state->mesh_count = 0;
+}
+
+// Frames too small to keep every thread busy on tiles render side by side instead
+int get_scene_frame_batch_size(const Scene* scene) {
+    int threads = omp_get_max_threads();
+    if (threads < 2) return 1;
+
+    // Batch workers render without preview passes and ray queues, keep those frames whole
+    if (scene->progressive || scene->wavefront) return 1;
+
+    int width = scene->width, height = scene->height;
+    if (scene->dynamic_resolution) {
+        width = (int)(scene->output_width * scene->resolution.scale);
+        height = (int)(scene->output_height * scene->resolution.scale);
+    }
+    int tiles = ((width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE) *
+                ((height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE);
+    return tiles >= FRAME_BATCH_TILES_PER_THREAD * threads ? 1 : threads;
+}
+
+static void apply_frame_state(Scene* scene, const FrameState* state) {
+    scene->camera = state->camera;
+    scene->light = state->light;
+    for (size_t m = 0; m < scene->mesh_count && m < state->mesh_count; m++) {
+        scene->meshes[m].transform = state->transforms[m];
+        update_mesh_transform(&scene->meshes[m]);
+    }
+    set_scene_frame(scene, state->frame);
+}
+
+void render_scene_frames(Scene* scene, const FrameState* states, int count) {
+    if (count <= 0) return;
+    if (count == 1) {
+        // Big frames keep intra-frame parallelism and incremental updates
+        apply_frame_state(scene, &states[0]);
+        render_scene(scene);
+        return;
+    }
+
+    // The whole batch shares one resolution, the controller sees the amortized frame time
+    double start_time = get_time_seconds();
+    apply_scene_resolution(scene);
+
+    // Shared by all workers, so it has to be current before they start
+    update_scene_light_tree(scene);
+    update_scene_transforms(scene);
+    update_mesh_replicas(scene);
+
+    // Workers trace private Mesh copies, so a lazy split would bump a private node count while
+    // writing into the shared node pool. Splitting everything up front leaves the trees read-only.
+    complete_scene_accels(scene);
+
+    // Workers do not fill the G-buffer, so there is nothing to relight afterwards
+    scene->gbuffer.frame = -1;
+
+    // Nor do they use the stage queues, the stage table reports how many frames went around them
+    if (scene->wavefront) scene->wavefront->batched_frames += count;
+
+    #pragma omp parallel
+    {
+        // Each worker renders whole frames on a private view of the scene, the
+        // nested parallel regions inside render_scene run on this thread alone
+        Mesh* meshes = (Mesh*)malloc(scene->mesh_count * sizeof(Mesh));
+        OccluderMap occluder_map = create_occluder_map(OCCLUDER_MAP_RESOLUTION);
+        VisibilityBuffer visibility = create_visibility_buffer(0, 0);
+        int thread = omp_get_thread_num() + 1;
+        double busy_start = get_time_seconds();
+
+        #pragma omp for schedule(dynamic, 1) nowait
+        for (int i = 0; i < count; i++) {
+            Scene view = *scene;
+            memcpy(meshes, get_thread_meshes(scene), scene->mesh_count * sizeof(Mesh));
+            view.meshes = meshes;
+            apply_frame_state(&view, &states[i]);
+            view.incremental = false;
+            view.dynamic_resolution = false;
+            view.progressive = false;
+            view.wavefront = NULL;
+            view.use_gbuffer = false;
+            view.numa = false;
+            view.mesh_replicas = NULL;
+            view.occluder_map = occluder_map;
+            view.visibility = visibility;
+            view.telemetry = NULL;
+            reset_traversal_stats(&view.stats);
+
+            double frame_start = get_time_seconds();
+            render_scene(&view);
+            if (scene->telemetry) {
+                record_telemetry_event(scene->telemetry, STAGE_RENDER, view.current_frame, thread,
+                                       frame_start, get_time_seconds());
+            }
+
+            // Buffers may have grown
+            occluder_map = view.occluder_map;
+            visibility = view.visibility;
+#ifdef RAYTRACER_STATS
+            #pragma omp critical
+            merge_traversal_stats(&scene->stats, &view.stats);
+#endif
+        }
+
+        double busy_end = get_time_seconds();
+        #pragma omp barrier
+        if (scene->telemetry) {
+            record_telemetry_event(scene->telemetry, STAGE_BUSY, states[0].frame, thread,
+                                   busy_start, busy_end);
+            record_telemetry_event(scene->telemetry, STAGE_IDLE, states[0].frame, thread,
+                                   busy_end, get_time_seconds());
+        }
+        destroy_visibility_buffer(&visibility);
+        destroy_occluder_map(&occluder_map);
+        free(meshes);
+    }
+
+    // Leave the scene at the last frame of the batch
+    apply_frame_state(scene, &states[count - 1]);
+    if (scene->dynamic_resolution) {
+        float frame_ms = (float)((get_time_seconds() - start_time) * 1000.0 / count);
+        update_resolution_controller(&scene->resolution, frame_ms);
+    }
+}
+
+void upscale_frame(const Scene* scene, int frame, uint32_t* argb) {
+    int scaled_width = scene->output_width;
+    int scaled_height = scene->output_height;
+
+    // Frames may have been rendered at different resolutions
+    int frame_width = scene->frame_widths[frame];
+    int frame_height = scene->frame_heights[frame];
+
+    // Scale up the frame using bicubic interpolation
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < scaled_height; y++) {
+        for (int x = 0; x < scaled_width; x++) {
+            float src_x = x * (frame_width - 1.0f) / (scaled_width - 1.0f);
+            float src_y = y * (frame_height - 1.0f) / (scaled_height - 1.0f);
+            
+            argb[y * scaled_width + x] = bicubic_interpolate(
+                scene->frames[frame],
+                src_x,
+                src_y,
+                frame_width,
+                frame_height
+            );
+        }
     }
 }
 
 void save_scene(Scene* scene, const char* filename) {
-    // Calculate scaled dimensions
-    int scaled_width = (int)(scene->width / scene->scale_factor + 0.5f);
-    int scaled_height = (int)(scene->height / scene->scale_factor + 0.5f);
+    // Frames are upscaled to the output dimensions
+    int scaled_width = scene->output_width;
+    int scaled_height = scene->output_height;
 
     // Prepare WebP animation configuration
     WebPAnimEncoderOptions anim_config;
@@ -184,39 +1037,37 @@ void save_scene(Scene* scene, const char* filename) {
 
     // Add each frame to the animation
     for (int frame = 0; frame < scene->frame_count; frame++) {
-        // Scale up the frame using bicubic interpolation
-        #pragma omp parallel for schedule(static)
-        for (int y = 0; y < scaled_height; y++) {
-            for (int x = 0; x < scaled_width; x++) {
-                float src_x = x * (scene->width - 1.0f) / (scaled_width - 1.0f);
-                float src_y = y * (scene->height - 1.0f) / (scaled_height - 1.0f);
-                
-                pic.argb[y * scaled_width + x] = bicubic_interpolate(
-                    scene->frames[frame],
-                    src_x,
-                    src_y,
-                    scene->width,
-                    scene->height
-                );
-            }
-        }
+        double upscale_start = get_time_seconds();
+        upscale_frame(scene, frame, pic.argb);
         
+        double encode_start = get_time_seconds();
         int timestamp = frame * (scene->duration_ms / scene->frame_count);
         WebPAnimEncoderAdd(enc, &pic, timestamp, &config);
+
+        if (scene->telemetry) {
+            record_telemetry_event(scene->telemetry, STAGE_UPSCALE, frame, 0, upscale_start, encode_start);
+            record_telemetry_event(scene->telemetry, STAGE_ENCODE, frame, 0, encode_start, get_time_seconds());
+        }
     }
     
     // Finalize animation
+    double assemble_start = get_time_seconds();
     WebPAnimEncoderAdd(enc, NULL, scene->duration_ms, NULL);
     WebPData webp_data;
     WebPDataInit(&webp_data);
     WebPAnimEncoderAssemble(enc, &webp_data);
     
     // Save to file
+    double write_start = get_time_seconds();
     FILE* fp = fopen(filename, "wb");
     if (fp) {
         fwrite(webp_data.bytes, webp_data.size, 1, fp);
         fclose(fp);
     }
+    if (scene->telemetry) {
+        record_telemetry_event(scene->telemetry, STAGE_ENCODE, -1, 0, assemble_start, write_start);
+        record_telemetry_event(scene->telemetry, STAGE_WRITE, -1, 0, write_start, get_time_seconds());
+    }
     
     // Cleanup
     WebPDataClear(&webp_data);
@@ -224,16 +1075,138 @@ void save_scene(Scene* scene, const char* filename) {
     WebPPictureFree(&pic);
 }
 
+// Map a normalized cost to a blue-green-red ramp
+static uint32_t heatmap_color(float t) {
+    float r = fminf(fmaxf(2.0f * t - 1.0f, 0.0f), 1.0f);
+    float g = 1.0f - fabsf(2.0f * t - 1.0f);
+    float b = fminf(fmaxf(1.0f - 2.0f * t, 0.0f), 1.0f);
+    return (0xFF << 24) | ((int)(r * 255.0f) << 16) | ((int)(g * 255.0f) << 8) | (int)(b * 255.0f);
+}
+
+void save_scene_heatmap(Scene* scene, const char* filename) {
+    if (!scene->cost_frames) return;
+
+    // Normalize against the most expensive pixel of the whole animation
+    uint16_t max_cost = 1;
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        int count = scene->frame_widths[frame] * scene->frame_heights[frame];
+        for (int i = 0; i < count; i++) {
+            if (scene->cost_frames[frame][i] > max_cost) max_cost = scene->cost_frames[frame][i];
+        }
+    }
+
+    WebPAnimEncoderOptions anim_config;
+    WebPAnimEncoderOptionsInit(&anim_config);
+    WebPAnimEncoder* enc = WebPAnimEncoderNew(scene->output_width, scene->output_height, &anim_config);
+
+    WebPConfig config;
+    WebPConfigInit(&config);
+    config.image_hint = WEBP_HINT_GRAPH;
+
+    WebPPicture pic;
+    WebPPictureInit(&pic);
+    pic.width = scene->output_width;
+    pic.height = scene->output_height;
+    pic.use_argb = 1;
+    WebPPictureAlloc(&pic);
+
+    for (int frame = 0; frame < scene->frame_count; frame++) {
+        int frame_width = scene->frame_widths[frame];
+        int frame_height = scene->frame_heights[frame];
+
+        // Nearest neighbour keeps the per-pixel costs intact
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < pic.height; y++) {
+            for (int x = 0; x < pic.width; x++) {
+                int src_x = x * frame_width / pic.width;
+                int src_y = y * frame_height / pic.height;
+                float cost = scene->cost_frames[frame][src_y * frame_width + src_x];
+                pic.argb[y * pic.width + x] = heatmap_color(cost / max_cost);
+            }
+        }
+
+        int timestamp = frame * (scene->duration_ms / scene->frame_count);
+        WebPAnimEncoderAdd(enc, &pic, timestamp, &config);
+    }
+
+    WebPAnimEncoderAdd(enc, NULL, scene->duration_ms, NULL);
+    WebPData webp_data;
+    WebPDataInit(&webp_data);
+    WebPAnimEncoderAssemble(enc, &webp_data);
+
+    FILE* fp = fopen(filename, "wb");
+    if (fp) {
+        fwrite(webp_data.bytes, webp_data.size, 1, fp);
+        fclose(fp);
+    }
+
+    WebPDataClear(&webp_data);
+    WebPAnimEncoderDelete(enc);
+    WebPPictureFree(&pic);
+}
+
+bool save_scene_frame(const Scene* scene, int frame, const char* directory) {
+    FrameHeader header = {
+        .magic = FRAME_FILE_MAGIC,
+        .version = FRAME_FILE_VERSION,
+        .frame = frame,
+        .frame_count = scene->frame_count,
+        .width = scene->frame_widths[frame],
+        .height = scene->frame_heights[frame],
+        .output_width = scene->output_width,
+        .output_height = scene->output_height,
+        .duration_ms = scene->duration_ms
+    };
+    char filename[1024];
+    get_frame_filename(filename, sizeof(filename), directory, frame);
+    return write_frame_file(filename, &header, scene->frames[frame]);
+}
+
+bool load_scene_frame(Scene* scene, int frame, const char* directory) {
+    char filename[1024];
+    get_frame_filename(filename, sizeof(filename), directory, frame);
+
+    FrameHeader header;
+    if (!read_frame_file(filename, &header, scene->frames[frame], scene->frame_capacity)) return false;
+
+    // Frames only belong to this animation if it was set up identically
+    if (header.frame != frame || header.frame_count != scene->frame_count ||
+        header.output_width != scene->output_width || header.output_height != scene->output_height ||
+        header.duration_ms != scene->duration_ms) {
+        fprintf(stderr, "Frame file %s does not match the scene settings\n", filename);
+        return false;
+    }
+    scene->frame_widths[frame] = header.width;
+    scene->frame_heights[frame] = header.height;
+
+    // The tracker can no longer assume it knows this frame's contents
+    invalidate_dirty_tracker(&scene->dirty);
+    return true;
+}
+
 void destroy_scene(Scene* scene) {
     free(scene->meshes);
-    
-    // Free all frame buffers
-    for (int i = 0; i < scene->frame_count; i++) {
-        free(scene->frames[i]);
-    }
-    free(scene->frames);
-    
+    destroy_dirty_tracker(&scene->dirty);
+    destroy_occluder_map(&scene->occluder_map);
+    destroy_visibility_buffer(&scene->visibility);
+    destroy_gbuffer(&scene->gbuffer);
+    destroy_light_tree(&scene->light_tree);
+    free(scene->lights);
+    free(scene->light_tree_lights);
+    set_scene_heatmap(scene, false);
+    set_scene_numa(scene, false);
+
+    // Frame buffers live in the scene arena
+    destroy_arena(&scene->arena);
+
     scene->meshes = NULL;
+    scene->lights = NULL;
+    scene->light_count = 0;
+    scene->light_tree_lights = NULL;
+    scene->light_tree_light_count = 0;
     scene->frames = NULL;
+    scene->frame_widths = NULL;
+    scene->frame_heights = NULL;
     scene->mesh_count = 0;
+    scene->mesh_capacity = 0;
 }
\ No newline at end of file
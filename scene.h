@@ -4,35 +4,167 @@
 #include "geometry/mesh.h"
 #include "render/camera.h"
 #include "render/light.h"
+#include "render/light_tree.h"
+#include "render/dirty.h"
+#include "render/resolution.h"
+#include "render/visibility.h"
+#include "render/gbuffer.h"
+#include "accel/occluder_map.h"
+#include "utils/stats.h"
+#include "utils/telemetry.h"
+#include "utils/frame_store.h"
 #include "utils/progress.h"
 #include "utils/image.h"
+#include "utils/numa.h"
 #include <webp/encode.h>
 #include <webp/mux.h>
 #include <time.h>
 
+#define FRAME_BATCH_TILES_PER_THREAD 16  // Below this many tiles per thread, frames render side by side
+#define PROGRESSIVE_FIRST_STEP 8          // Pixel spacing of the first progressive pass
+#define SCENE_BACKGROUND 50               // Grey level of pixels that hit nothing
+#define LIGHT_SAMPLE_COUNT 2              // Local lights sampled per shading point, independent of the light count
+
+struct Scene;
+struct Wavefront;
+
+// Called after each progressive pass with the partially refined current frame
+typedef void (*ProgressiveCallback)(const struct Scene* scene, int pass, int step, void* user_data);
+
+typedef struct {
+    float t;                    // Distance along the ray
+    float u, v;                 // Barycentric coordinates within the triangle
+    int mesh_index;
+    int triangle_index;
+} SceneHit;
+
+// Surface attributes at a primary hit, everything lighting needs
+typedef struct {
+    Vec3 albedo;
+    Vec3 normal;                // World space
+    Vec3 point;
+    Vec3 shadow_origin;         // Offset along the normal against self-intersection
+} SurfaceSample;
+
+// One light tree sample at a surface, adds radiance unless its shadow ray is blocked within distance
 typedef struct {
+    Ray shadow_ray;
+    float distance;
+    Vec3 radiance;
+} LocalLightSample;
+
+typedef struct Scene {
     Mesh* meshes;
     size_t mesh_count;
+    size_t mesh_capacity;
     Camera camera;
     DirectionalLight light;
+    Light* lights;              // Point and spot lights, sampled through the light tree
+    int light_count;
+    int light_capacity;
+    LightTree light_tree;
+    Light* light_tree_lights;   // Lights the tree was built from, edits in place trigger a rebuild
+    int light_tree_light_count;
+    Arena arena;                // Owns the frame buffers and per-frame metadata
     unsigned char** frames;
+    size_t frame_capacity;      // Size in bytes of each frame buffer
+    int* frame_widths;          // Render resolution of each frame
+    int* frame_heights;
     int frame_count;
     int current_frame;
-    int width;
+    int width;                  // Render resolution of the current frame
     int height;
+    int output_width;           // Resolution frames are upscaled to when saved
+    int output_height;
     float scale_factor;
     int duration_ms;
     int fps;
+    bool incremental;
+    DirtyTracker dirty;
+    bool use_occluder_map;
+    OccluderMap occluder_map;
+    bool use_visibility_buffer; // Rasterize primary visibility instead of tracing camera rays
+    bool visibility_active;     // This frame's primary hits were rasterized, off while meshes are paged
+    VisibilityBuffer visibility;
+    bool use_gbuffer;           // Keep primary hit data of the last render for relighting
+    GBuffer gbuffer;
+    bool dynamic_resolution;
+    ResolutionController resolution;
+    TraversalStats stats;       // Accumulated over all rendered frames with -DRAYTRACER_STATS
+    uint16_t** cost_frames;     // Per-pixel traversal cost of each frame, NULL unless enabled
+    Telemetry* telemetry;       // Stage and thread timings, NULL unless enabled
+    bool progressive;           // Render coarse-to-fine passes instead of tile by tile
+    ProgressiveCallback progressive_callback;
+    void* progressive_user_data;
+    struct Wavefront* wavefront; // Queue-based renderer, NULL for the per-pixel tile loop
+    bool numa;                  // Pinned render threads reading node-local mesh replicas
+    NumaTopology numa_topology;
+    int* numa_thread_nodes;     // Node of each render thread
+    int numa_thread_count;
+    Mesh** mesh_replicas;       // Per node copies of every mesh, NULL on single-node machines
+    size_t replica_mesh_count;
 } Scene;
 
+// Snapshot of everything animation changes, so frames can render independently
+typedef struct {
+    int frame;
+    Camera camera;
+    DirectionalLight light;
+    Transform* transforms;      // One per mesh
+    size_t mesh_count;
+} FrameState;
+
 // Scene management
 Scene create_scene(int width, int height, int duration_ms, int fps, float scale_factor);
 void add_mesh_to_scene(Scene* scene, Mesh mesh);
 void set_scene_camera(Scene* scene, Vec3 position, Vec3 look_at, Vec3 up, float fov);
 void set_scene_light(Scene* scene, Vec3 direction, Vec3 color);
+void add_light_to_scene(Scene* scene, Light light);
+bool set_scene_light_at(Scene* scene, int index, Light light);
+bool remove_light_from_scene(Scene* scene, int index);
+void set_scene_incremental(Scene* scene, bool enabled);
+void set_scene_occluder_map(Scene* scene, bool enabled);
+void set_scene_visibility_buffer(Scene* scene, bool enabled);
+void set_scene_gbuffer(Scene* scene, bool enabled);
+void set_scene_dynamic_resolution(Scene* scene, float target_ms, float min_scale);
+void set_scene_heatmap(Scene* scene, bool enabled);
+void set_scene_telemetry(Scene* scene, Telemetry* telemetry);
+void set_scene_progressive(Scene* scene, bool enabled, ProgressiveCallback callback, void* user_data);
+void set_scene_wavefront(Scene* scene, struct Wavefront* wavefront);
+// Call after adding meshes and again after modifying their triangles, replicas are copies.
+// Pins the OpenMP pool of the calling thread, so call it from the thread that renders.
+void set_scene_numa(Scene* scene, bool enabled);
+// Node-local mesh copies for the calling OpenMP thread, the scene meshes without NUMA replicas
+Mesh* get_thread_meshes(const Scene* scene);
+void set_scene_frame(Scene* scene, int frame);
 void next_frame(Scene* scene);
+void update_scene_acceleration(Scene* scene);
 void render_scene(Scene* scene);
+bool relight_scene(Scene* scene);
+void capture_frame_state(const Scene* scene, int frame, FrameState* state);
+void destroy_frame_state(FrameState* state);
+int get_scene_frame_batch_size(const Scene* scene);
+void render_scene_frames(Scene* scene, const FrameState* states, int count);
+void upscale_frame(const Scene* scene, int frame, uint32_t* argb);
 void save_scene(Scene* scene, const char* filename);
+void save_scene_heatmap(Scene* scene, const char* filename);
+bool save_scene_frame(const Scene* scene, int frame, const char* directory);
+bool load_scene_frame(Scene* scene, int frame, const char* directory);
 void destroy_scene(Scene* scene);
 
+// Ray queries against the current scene state
+bool intersect_scene(const Scene* scene, Ray ray, SceneHit* hit);
+bool occluded_scene(const Scene* scene, Ray shadow_ray);
+bool occluded_scene_within(const Scene* scene, Ray shadow_ray, float max_distance);
+
+// Shading stages, shared by the per-pixel and the wavefront renderer
+bool get_scene_primary_hit(const Scene* scene, int x, int y, Ray ray, SceneHit* hit);
+SurfaceSample get_scene_surface(const Scene* scene, Ray ray, const SceneHit* hit);
+Vec3 get_scene_radiance(const Scene* scene, const SurfaceSample* surface, bool in_shadow, int x, int y);
+// Split form of get_scene_radiance for renderers that trace the local light shadow rays themselves
+int sample_scene_local_lights(const Scene* scene, const SurfaceSample* surface, int x, int y,
+                              LocalLightSample samples[LIGHT_SAMPLE_COUNT]);
+Vec3 get_scene_lit_radiance(const Scene* scene, const SurfaceSample* surface, bool in_shadow, Vec3 local_radiance);
+void store_scene_pixel(unsigned char* frame, int idx, Vec3 color);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "server.h"
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
+
+static void send_reply(int client, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > (int)sizeof(line) - 1) length = sizeof(line) - 1;
+    // A client that hung up must not take the server down with SIGPIPE
+    if (length > 0) send(client, line, length, MSG_NOSIGNAL);
+}
+
+// One request per connection, terminated by a newline or by the client closing its end.
+// Requests are read on the accepting thread, so a client that stalls is dropped after the
+// receive timeout instead of holding up everyone queueing behind it.
+static bool read_request(int client, char* buffer, size_t size) {
+    struct timeval timeout = {SERVER_REQUEST_TIMEOUT_MS / 1000, (SERVER_REQUEST_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    size_t length = 0;
+    while (length < size - 1) {
+        ssize_t n = recv(client, buffer + length, size - 1 - length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            send_reply(client, "error request timed out\n");
+            return false;
+        }
+        if (n <= 0) break;
+        length += n;
+        if (memchr(buffer + length - n, '\n', n)) break;
+    }
+    buffer[length] = '\0';
+    char* end = strchr(buffer, '\n');
+    if (end) *end = '\0';
+    return length > 0;
+}
+
+// render frames=START:END[:STEP] output=DIR [camera=PX,PY,PZ,LX,LY,LZ] [fov=DEG] [mesh=I,PX,PY,PZ,RX,RY,RZ]...
+static bool parse_job(char* request, const Scene* scene, RenderJob* job) {
+    char* save = NULL;
+    char* token = strtok_r(request, " \t", &save);
+    if (!token || strcmp(token, "render") != 0) return false;
+
+    *job = (RenderJob){.first_frame = 0, .last_frame = scene->frame_count, .frame_step = 1, .camera_fov = 60.0f};
+    while ((token = strtok_r(NULL, " \t", &save))) {
+        if (strncmp(token, "frames=", 7) == 0) {
+            int count = sscanf(token + 7, "%d:%d:%d", &job->first_frame, &job->last_frame, &job->frame_step);
+            if (count < 2) return false;
+        } else if (strncmp(token, "output=", 7) == 0) {
+            snprintf(job->output_dir, sizeof(job->output_dir), "%s", token + 7);
+        } else if (strncmp(token, "camera=", 7) == 0) {
+            Vec3* p = &job->camera_position;
+            Vec3* l = &job->camera_look_at;
+            if (sscanf(token + 7, "%f,%f,%f,%f,%f,%f", &p->x, &p->y, &p->z, &l->x, &l->y, &l->z) != 6) return false;
+            job->has_camera = true;
+        } else if (strncmp(token, "fov=", 4) == 0) {
+            job->camera_fov = strtof(token + 4, NULL);
+        } else if (strncmp(token, "mesh=", 5) == 0 && job->override_count < SERVER_MAX_TRANSFORMS) {
+            MeshOverride* o = &job->overrides[job->override_count];
+            if (sscanf(token + 5, "%d,%f,%f,%f,%f,%f,%f", &o->mesh_index,
+                       &o->position.x, &o->position.y, &o->position.z,
+                       &o->rotation.x, &o->rotation.y, &o->rotation.z) != 7) return false;
+            if (o->mesh_index < 0 || (size_t)o->mesh_index >= scene->mesh_count) return false;
+            job->override_count++;
+        } else {
+            return false;
+        }
+    }
+
+    if (job->last_frame > scene->frame_count) job->last_frame = scene->frame_count;
+    return job->output_dir[0] && job->first_frame >= 0 && job->frame_step > 0 &&
+           job->first_frame < job->last_frame;
+}
+
+static void place_job_frame(RenderServer* server, const RenderJob* job, int frame) {
+    Scene* scene = server->scene;
+    scene->camera = server->base.camera;
+    for (size_t m = 0; m < scene->mesh_count && m < server->base.mesh_count; m++) {
+        scene->meshes[m].transform = server->base.transforms[m];
+    }
+    if (server->animate) server->animate(scene, frame);
+    if (job->has_camera) {
+        set_scene_camera(scene, job->camera_position, job->camera_look_at, (Vec3){0, 1, 0}, job->camera_fov);
+    }
+    for (int i = 0; i < job->override_count; i++) {
+        Mesh* mesh = &scene->meshes[job->overrides[i].mesh_index];
+        set_mesh_position(mesh, job->overrides[i].position);
+        set_mesh_rotation(mesh, job->overrides[i].rotation);
+    }
+}
+
+// Same batching as the command line renderer, meshes and BVHs stay resident between jobs
+static bool render_job(RenderServer* server, const RenderJob* job) {
+    Scene* scene = server->scene;
+    if (!create_frame_directory(job->output_dir)) return false;
+
+    int max_batch = get_scene_frame_batch_size(scene);
+    FrameState* states = (FrameState*)calloc(max_batch, sizeof(FrameState));
+    bool ok = true;
+    int frame = job->first_frame;
+    while (frame < job->last_frame && ok) {
+        int count = 0;
+        int batch_size = get_scene_frame_batch_size(scene);
+        if (batch_size > max_batch) batch_size = max_batch;
+        for (; frame < job->last_frame && count < batch_size; frame += job->frame_step) {
+            place_job_frame(server, job, frame);
+            capture_frame_state(scene, frame, &states[count++]);
+        }
+        render_scene_frames(scene, states, count);
+        for (int i = 0; i < count && ok; i++) ok = save_scene_frame(scene, states[i].frame, job->output_dir);
+    }
+
+    for (int i = 0; i < max_batch; i++) destroy_frame_state(&states[i]);
+    free(states);
+    return ok;
+}
+
+static void* run_render_worker(void* arg) {
+    RenderServer* server = (RenderServer*)arg;
+
+    // Pinning applies to the calling thread's OpenMP pool, which for the server is this thread's
+    if (server->numa) set_scene_numa(server->scene, true);
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (!server->head && !server->stopping) pthread_cond_wait(&server->ready, &server->lock);
+        RenderJob* job = server->head;
+        if (!job) {
+            pthread_mutex_unlock(&server->lock);
+            return NULL;
+        }
+        server->head = job->next;
+        if (!server->head) server->tail = NULL;
+        pthread_mutex_unlock(&server->lock);
+
+        double start_time = get_time_seconds();
+        if (render_job(server, job)) {
+            send_reply(job->client, "done %d %.3f\n", job->id, get_time_seconds() - start_time);
+        } else {
+            send_reply(job->client, "error %d could not write %s\n", job->id, job->output_dir);
+        }
+        close(job->client);
+        free(job);
+    }
+}
+
+bool open_render_server(RenderServer* server, Scene* scene, AnimateCallback animate, const char* socket_path,
+                        bool numa) {
+    memset(server, 0, sizeof(*server));
+    server->scene = scene;
+    server->animate = animate;
+    server->numa = numa;
+    server->next_id = 1;
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return false;
+    }
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+    snprintf(server->socket_path, sizeof(server->socket_path), "%s", socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        fprintf(stderr, "Failed to create socket: %s\n", strerror(errno));
+        return false;
+    }
+    unlink(socket_path);
+    if (bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, 16) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        close(server->listen_fd);
+        return false;
+    }
+
+    capture_frame_state(scene, 0, &server->base);
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->ready, NULL);
+    pthread_create(&server->worker, NULL, run_render_worker, server);
+    return true;
+}
+
+// Accept jobs until a client sends "shutdown", queued jobs still finish
+void run_render_server(RenderServer* server) {
+    char request[SERVER_MAX_REQUEST];
+    for (;;) {
+        int client = accept(server->listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to accept connection: %s\n", strerror(errno));
+            break;
+        }
+        if (!read_request(client, request, sizeof(request))) {
+            close(client);
+            continue;
+        }
+        if (strcmp(request, "shutdown") == 0) {
+            send_reply(client, "bye\n");
+            close(client);
+            break;
+        }
+
+        RenderJob* job = (RenderJob*)malloc(sizeof(RenderJob));
+        if (!parse_job(request, server->scene, job)) {
+            send_reply(client, "error invalid request\n");
+            close(client);
+            free(job);
+            continue;
+        }
+        job->client = client;
+
+        pthread_mutex_lock(&server->lock);
+        job->id = server->next_id++;
+        if (server->tail) server->tail->next = job;
+        else server->head = job;
+        server->tail = job;
+        send_reply(client, "queued %d\n", job->id);
+        pthread_cond_signal(&server->ready);
+        pthread_mutex_unlock(&server->lock);
+    }
+}
+
+void close_render_server(RenderServer* server) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = true;
+    pthread_cond_signal(&server->ready);
+    pthread_mutex_unlock(&server->lock);
+    pthread_join(server->worker, NULL);
+
+    close(server->listen_fd);
+    unlink(server->socket_path);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->ready);
+    destroy_frame_state(&server->base);
+}
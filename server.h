@@ -0,0 +1,58 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "scene.h"
+#include <pthread.h>
+
+#define SERVER_MAX_REQUEST 4096
+#define SERVER_MAX_TRANSFORMS 64
+#define SERVER_REQUEST_TIMEOUT_MS 1000  // A client must send its request line within this time
+
+// Places the scene at a frame of its animation before job overrides are applied
+typedef void (*AnimateCallback)(Scene* scene, int frame);
+
+typedef struct {
+    int mesh_index;
+    Vec3 position;
+    Vec3 rotation;
+} MeshOverride;
+
+typedef struct RenderJob {
+    int id;
+    int client;                 // Connection that receives the result line
+    int first_frame;            // Last frame is exclusive
+    int last_frame;
+    int frame_step;
+    char output_dir[1024];      // Frames are stored as in --shard-dir
+    bool has_camera;
+    Vec3 camera_position;
+    Vec3 camera_look_at;
+    float camera_fov;
+    MeshOverride overrides[SERVER_MAX_TRANSFORMS];
+    int override_count;
+    struct RenderJob* next;
+} RenderJob;
+
+typedef struct {
+    Scene* scene;               // Resident across jobs, only the worker thread touches it
+    AnimateCallback animate;
+    FrameState base;            // Camera and transforms at startup, job overrides never outlive their job
+    int listen_fd;
+    char socket_path[108];
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    RenderJob* head;            // Queued jobs, oldest first
+    RenderJob* tail;
+    int next_id;
+    bool numa;                  // Pin the worker's render threads and replicate meshes per node
+    bool stopping;
+} RenderServer;
+
+// Render server operations
+bool open_render_server(RenderServer* server, Scene* scene, AnimateCallback animate, const char* socket_path,
+                        bool numa);
+void run_render_server(RenderServer* server);
+void close_render_server(RenderServer* server);
+
+#endif
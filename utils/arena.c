@@ -0,0 +1,65 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+Arena create_arena(size_t block_size) {
+    return (Arena){NULL, block_size > 0 ? block_size : ARENA_BLOCK_SIZE, 0};
+}
+
+static ArenaBlock* create_arena_block(size_t size) {
+    // Block header and data share one allocation, data is aligned behind the header
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size + ARENA_ALIGNMENT);
+    if (!block) return NULL;
+    uintptr_t data = (uintptr_t)(block + 1);
+    data = (data + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+    block->data = (unsigned char*)data;
+    block->size = size;
+    block->used = 0;
+    block->next = NULL;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size, size_t alignment) {
+    ArenaBlock* block = arena->blocks;
+    size_t offset = 0;
+    if (block) offset = (block->used + alignment - 1) & ~(alignment - 1);
+
+    if (!block || offset + size > block->size) {
+        // Oversized requests get a block of their own
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = create_arena_block(block_size);
+        if (!block) return NULL;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        offset = 0;
+    }
+
+    block->used = offset + size;
+    arena->allocated += size;
+    return block->data + offset;
+}
+
+void reset_arena(Arena* arena) {
+    // Keep the most recent block around for reuse
+    if (!arena->blocks) return;
+    ArenaBlock* block = arena->blocks->next;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks->next = NULL;
+    arena->blocks->used = 0;
+    arena->allocated = 0;
+}
+
+void destroy_arena(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->allocated = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20)
+#define ARENA_ALIGNMENT 64
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    unsigned char* data;        // ARENA_ALIGNMENT aligned start of the usable memory
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* blocks;         // Most recent block first
+    size_t block_size;
+    size_t allocated;           // Bytes handed out since the last reset
+} Arena;
+
+// Bump allocator, everything is released at once
+Arena create_arena(size_t block_size);
+void* arena_alloc(Arena* arena, size_t size, size_t alignment);
+void reset_arena(Arena* arena);
+void destroy_arena(Arena* arena);
+
+#endif
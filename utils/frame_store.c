@@ -0,0 +1,55 @@
+#include "frame_store.h"
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+void get_frame_filename(char* buffer, size_t size, const char* directory, int frame) {
+    snprintf(buffer, size, "%s/frame_%05d.rgb", directory, frame);
+}
+
+bool create_frame_directory(const char* directory) {
+    if (mkdir(directory, 0755) == 0 || errno == EEXIST) return true;
+    fprintf(stderr, "Failed to create directory %s\n", directory);
+    return false;
+}
+
+bool write_frame_file(const char* filename, const FrameHeader* header, const unsigned char* pixels) {
+    // Write to a temporary file first so readers never see a partial frame
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+    FILE* fp = fopen(temp_filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", temp_filename);
+        return false;
+    }
+    size_t size = (size_t)header->width * header->height * 3;
+    bool ok = fwrite(header, sizeof(FrameHeader), 1, fp) == 1 &&
+              fwrite(pixels, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(temp_filename, filename) != 0) {
+        fprintf(stderr, "Failed to write %s\n", filename);
+        remove(temp_filename);
+        return false;
+    }
+    return true;
+}
+
+bool read_frame_file(const char* filename, FrameHeader* header, unsigned char* pixels, size_t capacity) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) return false;
+
+    bool ok = fread(header, sizeof(FrameHeader), 1, fp) == 1 &&
+              header->magic == FRAME_FILE_MAGIC &&
+              header->version == FRAME_FILE_VERSION &&
+              header->width > 0 && header->height > 0;
+    if (ok) {
+        size_t size = (size_t)header->width * header->height * 3;
+        ok = size <= capacity && fread(pixels, 1, size, fp) == size;
+    }
+    fclose(fp);
+
+    if (!ok) fprintf(stderr, "Invalid frame file %s\n", filename);
+    return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FRAME_FILE_MAGIC 0x52465452u   // "RTFR"
+#define FRAME_FILE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t frame;
+    int32_t frame_count;
+    int32_t width;              // Render resolution of the stored pixels
+    int32_t height;
+    int32_t output_width;       // Animation settings the frame was rendered for
+    int32_t output_height;
+    int32_t duration_ms;
+} FrameHeader;
+
+// Raw RGB frame files, one per frame, named frame_00000.rgb
+void get_frame_filename(char* buffer, size_t size, const char* directory, int frame);
+bool create_frame_directory(const char* directory);
+bool write_frame_file(const char* filename, const FrameHeader* header, const unsigned char* pixels);
+bool read_frame_file(const char* filename, FrameHeader* header, unsigned char* pixels, size_t capacity);
+
+#endif
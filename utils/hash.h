@@ -0,0 +1,12 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
+// 64-bit FNV-1a, chain calls by passing the previous hash as seed
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed);
+
+#endif
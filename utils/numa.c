@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+#include "numa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// CPUs the process may run on, read once since pinning later narrows the calling thread's own mask
+static cpu_set_t allowed_cpus;
+static bool allowed_cpus_valid = false;
+static pthread_once_t allowed_cpus_once = PTHREAD_ONCE_INIT;
+
+static void read_allowed_cpus(void) {
+    CPU_ZERO(&allowed_cpus);
+    allowed_cpus_valid = sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) == 0;
+}
+
+static bool is_cpu_allowed(long cpu) {
+    if (!allowed_cpus_valid) return true;
+    return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed_cpus);
+}
+
+// Parse a sysfs CPU list such as "0-3,8-11" into cpus, returns the number of allowed CPUs appended
+static int parse_cpu_list(const char* text, int** cpus, int* count, int* capacity) {
+    int added = 0;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (!is_cpu_allowed(cpu)) continue;
+            if (*count == *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 64;
+                *cpus = (int*)realloc(*cpus, *capacity * sizeof(int));
+            }
+            (*cpus)[(*count)++] = (int)cpu;
+            added++;
+        }
+        p = *end == ',' ? end + 1 : end;
+        if (*p == '\n') break;
+    }
+    return added;
+}
+
+NumaTopology get_numa_topology(void) {
+    NumaTopology topology = {0};
+    pthread_once(&allowed_cpus_once, read_allowed_cpus);
+    topology.node_offsets = (int*)malloc((NUMA_MAX_NODES + 1) * sizeof(int));
+    topology.node_offsets[0] = 0;
+    int count = 0, capacity = 0;
+
+    // Node ids may be sparse, memory-only nodes and nodes outside the affinity mask have no CPUs, all are skipped
+    for (int node = 0; node < NUMA_MAX_NODES; node++) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* fp = fopen(filename, "r");
+        if (!fp) continue;
+        char line[4096];
+        int added = fgets(line, sizeof(line), fp) ? parse_cpu_list(line, &topology.cpus, &count, &capacity) : 0;
+        fclose(fp);
+        if (added > 0) topology.node_offsets[++topology.node_count] = count;
+    }
+
+    if (topology.node_count == 0) {
+        count = 0;
+        if (allowed_cpus_valid) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (!CPU_ISSET(cpu, &allowed_cpus)) continue;
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 64;
+                    topology.cpus = (int*)realloc(topology.cpus, capacity * sizeof(int));
+                }
+                topology.cpus[count++] = cpu;
+            }
+        }
+        if (count == 0) {
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+            if (online < 1) online = 1;
+            topology.cpus = (int*)realloc(topology.cpus, online * sizeof(int));
+            for (long cpu = 0; cpu < online; cpu++) topology.cpus[cpu] = (int)cpu;
+            count = (int)online;
+        }
+        topology.node_count = 1;
+        topology.node_offsets[1] = count;
+    }
+    return topology;
+}
+
+int get_numa_thread_node(const NumaTopology* topology, int thread, int thread_count) {
+    if (thread_count < 1) return 0;
+    return (int)((long)thread * topology->node_count / thread_count);
+}
+
+bool pin_numa_thread(const NumaTopology* topology, int thread, int thread_count) {
+    int node = get_numa_thread_node(topology, thread, thread_count);
+    int first_thread = (int)(((long)node * thread_count + topology->node_count - 1) / topology->node_count);
+    int node_cpus = topology->node_offsets[node + 1] - topology->node_offsets[node];
+    int cpu = topology->cpus[topology->node_offsets[node] + (thread - first_thread) % node_cpus];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+void destroy_numa_topology(NumaTopology* topology) {
+    free(topology->cpus);
+    free(topology->node_offsets);
+    topology->cpus = NULL;
+    topology->node_offsets = NULL;
+    topology->node_count = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stdbool.h>
+
+#define NUMA_MAX_NODES 64
+
+typedef struct {
+    int node_count;             // 1 when the machine exposes no NUMA information
+    int* cpus;                  // Online CPUs in the process affinity mask, grouped by node
+    int* node_offsets;          // node_count + 1 entries into cpus
+} NumaTopology;
+
+// NUMA topology from sysfs restricted to the process affinity mask, nodes left without CPUs are dropped.
+// Falls back to a single node holding every allowed CPU
+NumaTopology get_numa_topology(void);
+// Node of a thread when thread_count threads are spread evenly over the nodes
+int get_numa_thread_node(const NumaTopology* topology, int thread, int thread_count);
+// Pin the calling thread to one CPU of its node
+bool pin_numa_thread(const NumaTopology* topology, int thread, int thread_count);
+void destroy_numa_topology(NumaTopology* topology);
+
+#endif
@@ -1,7 +1,8 @@
 #include "progress.h"
+#include "telemetry.h"
 #include <stdio.h>
 
-void update_progress_bar(int frame, int total_frames, clock_t start_time) {
+void update_progress_bar(int frame, int total_frames, double start_time) {
     printf("\r[");
     int barWidth = 30;
     int pos = barWidth * (frame + 1) / total_frames;
@@ -13,7 +14,9 @@ void update_progress_bar(int frame, int total_frames, clock_t start_time) {
     }
 
     float progress = (frame + 1.0f) / total_frames * 100.0f;
-    float elapsed = (clock() - start_time) / (float)CLOCKS_PER_SEC;
+
+    // Wall clock time, CPU time would add up across render threads
+    float elapsed = (float)(get_time_seconds() - start_time);
     float estimated_total = elapsed * total_frames / (frame + 1);
     float remaining = estimated_total - elapsed;
 
@@ -1,9 +1,7 @@
 #ifndef PROGRESS_H
 #define PROGRESS_H
 
-#include <time.h>
+// Progress reporting, start_time from get_time_seconds()
+void update_progress_bar(int frame, int total_frames, double start_time);
 
-// Progress reporting
-void update_progress_bar(int frame, int total_frames, clock_t start_time);
-
-#endif
\ No newline at end of file
+#endif
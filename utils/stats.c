@@ -0,0 +1,34 @@
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef RAYTRACER_STATS
+_Thread_local TraversalStats thread_traversal_stats;
+#endif
+
+void reset_traversal_stats(TraversalStats* stats) {
+    memset(stats, 0, sizeof(TraversalStats));
+}
+
+void merge_traversal_stats(TraversalStats* total, const TraversalStats* stats) {
+    total->rays += stats->rays;
+    total->node_visits += stats->node_visits;
+    total->box_tests += stats->box_tests;
+    total->triangle_tests += stats->triangle_tests;
+    total->triangle_hits += stats->triangle_hits;
+}
+
+// Work done for a ray, weighting a node visit and a triangle test equally
+uint64_t get_traversal_cost(const TraversalStats* stats) {
+    return stats->node_visits + stats->triangle_tests;
+}
+
+void print_traversal_stats(const TraversalStats* stats) {
+    double rays = stats->rays > 0 ? (double)stats->rays : 1.0;
+    printf("Traversal: %llu rays | %.1f nodes/ray | %.1f boxes/ray | %.1f triangles/ray | %.2f hits/ray\n",
+           (unsigned long long)stats->rays,
+           stats->node_visits / rays,
+           stats->box_tests / rays,
+           stats->triangle_tests / rays,
+           stats->triangle_hits / rays);
+}
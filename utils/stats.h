@@ -0,0 +1,28 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t rays;
+    uint64_t node_visits;
+    uint64_t box_tests;
+    uint64_t triangle_tests;
+    uint64_t triangle_hits;
+} TraversalStats;
+
+// Counters are only compiled in with -DRAYTRACER_STATS (make STATS=1)
+#ifdef RAYTRACER_STATS
+extern _Thread_local TraversalStats thread_traversal_stats;
+#define STATS_INC(field) (thread_traversal_stats.field++)
+#else
+#define STATS_INC(field) ((void)0)
+#endif
+
+// Statistics operations
+void reset_traversal_stats(TraversalStats* stats);
+void merge_traversal_stats(TraversalStats* total, const TraversalStats* stats);
+uint64_t get_traversal_cost(const TraversalStats* stats);
+void print_traversal_stats(const TraversalStats* stats);
+
+#endif
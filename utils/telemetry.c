@@ -0,0 +1,105 @@
+#include "telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* stage_names[STAGE_COUNT] = {
+    "animate", "render", "occluder_map", "visibility", "upscale", "encode", "write", "busy", "idle"
+};
+
+double get_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+Telemetry create_telemetry(int thread_count) {
+    Telemetry telemetry;
+    memset(&telemetry, 0, sizeof(telemetry));
+    telemetry.origin = get_time_seconds();
+    telemetry.thread_count = thread_count;
+    telemetry.thread_busy = (double*)calloc(thread_count, sizeof(double));
+    telemetry.thread_idle = (double*)calloc(thread_count, sizeof(double));
+    return telemetry;
+}
+
+void record_telemetry_event(Telemetry* telemetry, TelemetryStage stage, int frame, int thread,
+                            double start, double end) {
+    // Render threads report once per frame, a critical section is cheap enough
+    #pragma omp critical(telemetry)
+    {
+        if (telemetry->event_count == telemetry->event_capacity) {
+            telemetry->event_capacity = telemetry->event_capacity ? telemetry->event_capacity * 2 : 1024;
+            telemetry->events = (TelemetryEvent*)realloc(telemetry->events,
+                telemetry->event_capacity * sizeof(TelemetryEvent));
+        }
+        telemetry->events[telemetry->event_count++] = (TelemetryEvent){
+            stage, frame, thread, start - telemetry->origin, end - start
+        };
+
+        telemetry->stage_totals[stage] += end - start;
+        telemetry->stage_counts[stage]++;
+        if (thread > 0 && thread <= telemetry->thread_count) {
+            if (stage == STAGE_BUSY) telemetry->thread_busy[thread - 1] += end - start;
+            if (stage == STAGE_IDLE) telemetry->thread_idle[thread - 1] += end - start;
+        }
+    }
+}
+
+bool export_telemetry_trace(const Telemetry* telemetry, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return false;
+    }
+
+    // Chrome trace-event format, loadable in chrome://tracing or Perfetto
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(fp, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"main\"}}");
+    for (int t = 0; t < telemetry->thread_count; t++) {
+        fprintf(fp, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                    "\"args\": {\"name\": \"render %d\"}}", t + 1, t);
+    }
+    for (size_t i = 0; i < telemetry->event_count; i++) {
+        const TelemetryEvent* event = &telemetry->events[i];
+        fprintf(fp, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %d}}",
+                stage_names[event->stage], event->thread,
+                event->start * 1e6, event->duration * 1e6, event->frame);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
+void print_telemetry_summary(const Telemetry* telemetry) {
+    double wall = get_time_seconds() - telemetry->origin;
+
+    printf("%-12s %10s %8s %14s %8s\n", "Stage", "Total (s)", "Count", "Average (ms)", "Wall %");
+    for (int s = 0; s < STAGE_BUSY; s++) {
+        if (telemetry->stage_counts[s] == 0) continue;
+        printf("%-12s %10.3f %8d %14.3f %7.1f%%\n",
+               stage_names[s], telemetry->stage_totals[s], telemetry->stage_counts[s],
+               telemetry->stage_totals[s] * 1000.0 / telemetry->stage_counts[s],
+               wall > 0.0 ? telemetry->stage_totals[s] * 100.0 / wall : 0.0);
+    }
+
+    printf("%-10s %10s %10s %12s\n", "Thread", "Busy (s)", "Idle (s)", "Utilization");
+    for (int t = 0; t < telemetry->thread_count; t++) {
+        double total = telemetry->thread_busy[t] + telemetry->thread_idle[t];
+        printf("%-10d %10.3f %10.3f %11.1f%%\n", t,
+               telemetry->thread_busy[t], telemetry->thread_idle[t],
+               total > 0.0 ? telemetry->thread_busy[t] * 100.0 / total : 0.0);
+    }
+}
+
+void destroy_telemetry(Telemetry* telemetry) {
+    free(telemetry->events);
+    free(telemetry->thread_busy);
+    free(telemetry->thread_idle);
+    telemetry->events = NULL;
+    telemetry->thread_busy = NULL;
+    telemetry->thread_idle = NULL;
+    telemetry->event_count = telemetry->event_capacity = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef enum {
+    STAGE_ANIMATE,
+    STAGE_RENDER,
+    STAGE_OCCLUDER_MAP, // Light-space occluder map build, shadow rays are traced inside render
+    STAGE_VISIBILITY,   // Rasterized primary visibility pre-pass
+    STAGE_UPSCALE,
+    STAGE_ENCODE,
+    STAGE_WRITE,
+    STAGE_BUSY,         // Render thread working on tiles
+    STAGE_IDLE,         // Render thread waiting for the rest of the frame
+    STAGE_COUNT
+} TelemetryStage;
+
+typedef struct {
+    TelemetryStage stage;
+    int frame;
+    int thread;         // 0 for the main thread, 1 + OpenMP thread number for render threads
+    double start;       // Seconds since the telemetry was created
+    double duration;
+} TelemetryEvent;
+
+typedef struct {
+    TelemetryEvent* events;
+    size_t event_count;
+    size_t event_capacity;
+    double origin;
+    double stage_totals[STAGE_COUNT];
+    int stage_counts[STAGE_COUNT];
+    double* thread_busy;
+    double* thread_idle;
+    int thread_count;
+} Telemetry;
+
+// Monotonic wall clock in seconds
+double get_time_seconds(void);
+
+// Telemetry operations
+Telemetry create_telemetry(int thread_count);
+void record_telemetry_event(Telemetry* telemetry, TelemetryStage stage, int frame, int thread,
+                            double start, double end);
+bool export_telemetry_trace(const Telemetry* telemetry, const char* filename);
+void print_telemetry_summary(const Telemetry* telemetry);
+void destroy_telemetry(Telemetry* telemetry);
+
+#endif
@@ -0,0 +1,370 @@
+#include "wavefront.h"
+#include <string.h>
+
+static const char* stage_names[WAVEFRONT_STAGE_COUNT] = {
+    "generate", "extend", "shade", "shadow", "resolve"
+};
+
+static RayQueue create_ray_queue(size_t capacity) {
+    RayQueue queue;
+    queue.count = 0;
+    queue.capacity = capacity;
+    queue.pixels = (int*)malloc(capacity * sizeof(int));
+    queue.origin_x = (float*)malloc(capacity * sizeof(float));
+    queue.origin_y = (float*)malloc(capacity * sizeof(float));
+    queue.origin_z = (float*)malloc(capacity * sizeof(float));
+    queue.direction_x = (float*)malloc(capacity * sizeof(float));
+    queue.direction_y = (float*)malloc(capacity * sizeof(float));
+    queue.direction_z = (float*)malloc(capacity * sizeof(float));
+    queue.t = (float*)malloc(capacity * sizeof(float));
+    queue.u = (float*)malloc(capacity * sizeof(float));
+    queue.v = (float*)malloc(capacity * sizeof(float));
+    queue.mesh_index = (int*)malloc(capacity * sizeof(int));
+    queue.triangle_index = (int*)malloc(capacity * sizeof(int));
+    return queue;
+}
+
+static void destroy_ray_queue(RayQueue* queue) {
+    free(queue->pixels);
+    free(queue->origin_x);
+    free(queue->origin_y);
+    free(queue->origin_z);
+    free(queue->direction_x);
+    free(queue->direction_y);
+    free(queue->direction_z);
+    free(queue->t);
+    free(queue->u);
+    free(queue->v);
+    free(queue->mesh_index);
+    free(queue->triangle_index);
+    queue->count = queue->capacity = 0;
+}
+
+static void set_queue_ray(RayQueue* queue, size_t i, Ray ray) {
+    queue->origin_x[i] = ray.origin.x;
+    queue->origin_y[i] = ray.origin.y;
+    queue->origin_z[i] = ray.origin.z;
+    queue->direction_x[i] = ray.direction.x;
+    queue->direction_y[i] = ray.direction.y;
+    queue->direction_z[i] = ray.direction.z;
+}
+
+static Ray get_queue_ray(const RayQueue* queue, size_t i) {
+    return (Ray){
+        {queue->origin_x[i], queue->origin_y[i], queue->origin_z[i]},
+        {queue->direction_x[i], queue->direction_y[i], queue->direction_z[i]}
+    };
+}
+
+Wavefront create_wavefront(bool sort_shadow_rays) {
+    Wavefront wavefront;
+    memset(&wavefront, 0, sizeof(wavefront));
+    wavefront.rays = create_ray_queue(WAVEFRONT_WAVE_SIZE);
+    wavefront.shadow_rays = create_ray_queue(WAVEFRONT_WAVE_SIZE);
+    wavefront.surfaces = (SurfaceSample*)malloc(WAVEFRONT_WAVE_SIZE * sizeof(SurfaceSample));
+    wavefront.occluded = (unsigned char*)malloc(WAVEFRONT_WAVE_SIZE);
+    wavefront.shadow_order = (int*)malloc(WAVEFRONT_WAVE_SIZE * sizeof(int));
+    wavefront.sort_shadow_rays = sort_shadow_rays;
+    return wavefront;
+}
+
+// Local light queues are only needed once a scene has point or spot lights
+static void reserve_light_queues(Wavefront* wavefront) {
+    if (wavefront->light_samples) return;
+    wavefront->light_rays = create_ray_queue(WAVEFRONT_WAVE_SIZE * LIGHT_SAMPLE_COUNT);
+    wavefront->light_samples = (LocalLightSample*)malloc(WAVEFRONT_WAVE_SIZE * LIGHT_SAMPLE_COUNT *
+                                                         sizeof(LocalLightSample));
+    wavefront->light_offsets = (int*)malloc((WAVEFRONT_WAVE_SIZE + 1) * sizeof(int));
+    wavefront->light_occluded = (unsigned char*)malloc(WAVEFRONT_WAVE_SIZE * LIGHT_SAMPLE_COUNT);
+}
+
+// Dirty pixels in tile order so neighbouring rays stay together, clean tiles are copied now
+static size_t collect_dirty_pixels(Wavefront* wavefront, const Scene* scene, unsigned char* current_frame,
+                                   const unsigned char* previous_frame) {
+    size_t pixel_count = (size_t)scene->width * scene->height;
+    if (pixel_count > wavefront->pixel_capacity) {
+        wavefront->pixel_capacity = pixel_count;
+        wavefront->pixels = (int*)realloc(wavefront->pixels, pixel_count * sizeof(int));
+    }
+
+    int tiles_x = (scene->width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    int tiles_y = (scene->height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+    size_t count = 0;
+    for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+        int tile_x = tile % tiles_x;
+        int tile_y = tile / tiles_x;
+        int x0 = tile_x * DIRTY_TILE_SIZE;
+        int y0 = tile_y * DIRTY_TILE_SIZE;
+        int x1 = x0 + DIRTY_TILE_SIZE < scene->width ? x0 + DIRTY_TILE_SIZE : scene->width;
+        int y1 = y0 + DIRTY_TILE_SIZE < scene->height ? y0 + DIRTY_TILE_SIZE : scene->height;
+
+        if (previous_frame && !is_tile_dirty(&scene->dirty, tile_x, tile_y)) {
+            if (previous_frame != current_frame) {
+                for (int y = y0; y < y1; y++) {
+                    int idx = (y * scene->width + x0) * 3;
+                    memcpy(&current_frame[idx], &previous_frame[idx], (x1 - x0) * 3);
+                }
+            }
+            continue;
+        }
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) wavefront->pixels[count++] = y * scene->width + x;
+        }
+    }
+    return count;
+}
+
+static void generate_stage(Wavefront* wavefront, const Scene* scene, float aspect, const int* pixels, size_t count) {
+    RayQueue* rays = &wavefront->rays;
+    rays->count = count;
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < count; i++) {
+        int x = pixels[i] % scene->width;
+        int y = pixels[i] / scene->width;
+        rays->pixels[i] = pixels[i];
+        set_queue_ray(rays, i, get_camera_ray(&scene->camera,
+                                              (x + 0.5f) / scene->width,
+                                              (y + 0.5f) / scene->height,
+                                              aspect));
+    }
+}
+
+static void extend_stage(Wavefront* wavefront, const Scene* scene) {
+    RayQueue* rays = &wavefront->rays;
+
+    #pragma omp parallel
+    {
+        // Stages that read meshes trace against this thread's node-local copies, as render_tiles does
+        Scene local = *scene;
+        local.meshes = get_thread_meshes(scene);
+
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < rays->count; i++) {
+            SceneHit hit;
+            int x = rays->pixels[i] % scene->width;
+            int y = rays->pixels[i] / scene->width;
+            if (get_scene_primary_hit(&local, x, y, get_queue_ray(rays, i), &hit)) {
+                rays->t[i] = hit.t;
+                rays->u[i] = hit.u;
+                rays->v[i] = hit.v;
+                rays->mesh_index[i] = hit.mesh_index;
+                rays->triangle_index[i] = hit.triangle_index;
+            } else {
+                rays->mesh_index[i] = -1;
+            }
+        }
+    }
+}
+
+// Misses are written right away, hits become shadow rays towards the directional light
+// and, with local lights, one shadow ray per light tree sample
+static void shade_stage(Wavefront* wavefront, const Scene* scene, unsigned char* current_frame) {
+    const RayQueue* rays = &wavefront->rays;
+    RayQueue* shadow_rays = &wavefront->shadow_rays;
+
+    size_t count = 0;
+    for (size_t i = 0; i < rays->count; i++) {
+        if (rays->mesh_index[i] >= 0) {
+            shadow_rays->pixels[count] = (int)i;   // Camera ray index until compaction below
+            shadow_rays->mesh_index[count] = rays->mesh_index[i];
+            count++;
+        } else {
+            int idx = rays->pixels[i] * 3;
+            current_frame[idx] = current_frame[idx + 1] = current_frame[idx + 2] = SCENE_BACKGROUND;
+        }
+    }
+    shadow_rays->count = count;
+
+    bool local_lights = scene->light_count > 0;
+    if (local_lights) reserve_light_queues(wavefront);
+
+    #pragma omp parallel
+    {
+        Scene local = *scene;
+        local.meshes = get_thread_meshes(scene);
+
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < count; i++) {
+            int ray_index = shadow_rays->pixels[i];
+            SceneHit hit = {
+                rays->t[ray_index], rays->u[ray_index], rays->v[ray_index],
+                rays->mesh_index[ray_index], rays->triangle_index[ray_index]
+            };
+            wavefront->surfaces[i] = get_scene_surface(&local, get_queue_ray(rays, ray_index), &hit);
+            shadow_rays->pixels[i] = rays->pixels[ray_index];
+            set_queue_ray(shadow_rays, i, (Ray){wavefront->surfaces[i].shadow_origin, scene->light.direction});
+            if (local_lights) {
+                int pixel = shadow_rays->pixels[i];
+                wavefront->light_offsets[i + 1] =
+                    sample_scene_local_lights(&local, &wavefront->surfaces[i], pixel % scene->width,
+                                              pixel / scene->width, &wavefront->light_samples[i * LIGHT_SAMPLE_COUNT]);
+            }
+        }
+    }
+
+    // Compact the light samples into one queue, shadow_rays indices stand in for pixels
+    RayQueue* light_rays = &wavefront->light_rays;
+    light_rays->count = 0;
+    if (!local_lights) return;
+    wavefront->light_offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        const LocalLightSample* samples = &wavefront->light_samples[i * LIGHT_SAMPLE_COUNT];
+        int sample_count = wavefront->light_offsets[i + 1];
+        for (int s = 0; s < sample_count; s++) {
+            size_t j = light_rays->count++;
+            light_rays->pixels[j] = (int)i;
+            light_rays->t[j] = samples[s].distance;
+            set_queue_ray(light_rays, j, samples[s].shadow_ray);
+        }
+        wavefront->light_offsets[i + 1] = (int)light_rays->count;
+    }
+}
+
+static void sort_shadow_rays(Wavefront* wavefront, size_t mesh_count) {
+    const RayQueue* shadow_rays = &wavefront->shadow_rays;
+    if (!wavefront->sort_shadow_rays) {
+        for (size_t i = 0; i < shadow_rays->count; i++) wavefront->shadow_order[i] = (int)i;
+        return;
+    }
+
+    // Counting sort by mesh keeps each group's traversal in one BVH
+    size_t* offsets = (size_t*)calloc(mesh_count + 1, sizeof(size_t));
+    for (size_t i = 0; i < shadow_rays->count; i++) offsets[shadow_rays->mesh_index[i] + 1]++;
+    for (size_t m = 0; m < mesh_count; m++) offsets[m + 1] += offsets[m];
+    for (size_t i = 0; i < shadow_rays->count; i++) {
+        wavefront->shadow_order[offsets[shadow_rays->mesh_index[i]]++] = (int)i;
+    }
+    free(offsets);
+}
+
+static void shadow_stage(Wavefront* wavefront, const Scene* scene) {
+    const RayQueue* shadow_rays = &wavefront->shadow_rays;
+    const RayQueue* light_rays = &wavefront->light_rays;
+
+    #pragma omp parallel
+    {
+        Scene local = *scene;
+        local.meshes = get_thread_meshes(scene);
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (size_t i = 0; i < shadow_rays->count; i++) {
+            int ray_index = wavefront->shadow_order[i];
+            wavefront->occluded[ray_index] = occluded_scene(&local, get_queue_ray(shadow_rays, ray_index));
+        }
+
+        // Local lights are at a finite distance, so their rays stop at the light
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < light_rays->count; i++) {
+            wavefront->light_occluded[i] = occluded_scene_within(&local, get_queue_ray(light_rays, i),
+                                                                 light_rays->t[i]);
+        }
+    }
+}
+
+// Sums the unoccluded light samples in draw order, matching get_scene_radiance
+static void resolve_stage(Wavefront* wavefront, const Scene* scene, unsigned char* current_frame) {
+    const RayQueue* shadow_rays = &wavefront->shadow_rays;
+    bool local_lights = scene->light_count > 0;
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t i = 0; i < shadow_rays->count; i++) {
+        Vec3 local_radiance = {0, 0, 0};
+        if (local_lights) {
+            const LocalLightSample* samples = &wavefront->light_samples[i * LIGHT_SAMPLE_COUNT];
+            int first = wavefront->light_offsets[i];
+            for (int j = first; j < wavefront->light_offsets[i + 1]; j++) {
+                if (!wavefront->light_occluded[j]) {
+                    local_radiance = vec3_add(local_radiance, samples[j - first].radiance);
+                }
+            }
+        }
+        Vec3 color = get_scene_lit_radiance(scene, &wavefront->surfaces[i], wavefront->occluded[i], local_radiance);
+        store_scene_pixel(current_frame, shadow_rays->pixels[i] * 3, color);
+    }
+}
+
+static void add_stage_time(Wavefront* wavefront, WavefrontStage stage, double start, size_t items) {
+    wavefront->stage_seconds[stage] += get_time_seconds() - start;
+    wavefront->stage_items[stage] += items;
+}
+
+void render_wavefront(Scene* scene, float aspect, unsigned char* current_frame,
+                      const unsigned char* previous_frame) {
+    Wavefront* wavefront = scene->wavefront;
+    size_t pixel_count = collect_dirty_pixels(wavefront, scene, current_frame, previous_frame);
+
+#ifdef RAYTRACER_STATS
+    // Counters stay thread local across the stage loops and are folded in once at the end
+    #pragma omp parallel
+    reset_traversal_stats(&thread_traversal_stats);
+#endif
+
+    for (size_t start = 0; start < pixel_count; start += WAVEFRONT_WAVE_SIZE) {
+        size_t count = pixel_count - start < WAVEFRONT_WAVE_SIZE ? pixel_count - start : WAVEFRONT_WAVE_SIZE;
+
+        double stage_start = get_time_seconds();
+        generate_stage(wavefront, scene, aspect, &wavefront->pixels[start], count);
+        add_stage_time(wavefront, WAVEFRONT_GENERATE, stage_start, count);
+
+        stage_start = get_time_seconds();
+        extend_stage(wavefront, scene);
+        add_stage_time(wavefront, WAVEFRONT_EXTEND, stage_start, count);
+
+        stage_start = get_time_seconds();
+        shade_stage(wavefront, scene, current_frame);
+        sort_shadow_rays(wavefront, scene->mesh_count);
+        add_stage_time(wavefront, WAVEFRONT_SHADE, stage_start, count);
+
+        stage_start = get_time_seconds();
+        shadow_stage(wavefront, scene);
+        add_stage_time(wavefront, WAVEFRONT_SHADOW, stage_start,
+                       wavefront->shadow_rays.count + wavefront->light_rays.count);
+
+        stage_start = get_time_seconds();
+        resolve_stage(wavefront, scene, current_frame);
+        add_stage_time(wavefront, WAVEFRONT_RESOLVE, stage_start, wavefront->shadow_rays.count);
+    }
+
+#ifdef RAYTRACER_STATS
+    #pragma omp parallel
+    {
+        #pragma omp critical
+        merge_traversal_stats(&scene->stats, &thread_traversal_stats);
+    }
+#endif
+}
+
+void print_wavefront_stats(const Wavefront* wavefront) {
+    printf("\n%-9s %10s %12s %10s\n", "Stage", "Items", "Time (s)", "Mitems/s");
+    for (int s = 0; s < WAVEFRONT_STAGE_COUNT; s++) {
+        double seconds = wavefront->stage_seconds[s];
+        printf("%-9s %10zu %12.3f %10.2f\n", stage_names[s], wavefront->stage_items[s], seconds,
+               seconds > 0.0 ? wavefront->stage_items[s] / seconds / 1e6 : 0.0);
+    }
+    if (wavefront->batched_frames > 0) {
+        fprintf(stderr, "%zu small frames rendered side by side bypassed the stage queues and are missing above\n",
+                wavefront->batched_frames);
+    }
+}
+
+void destroy_wavefront(Wavefront* wavefront) {
+    destroy_ray_queue(&wavefront->rays);
+    destroy_ray_queue(&wavefront->shadow_rays);
+    free(wavefront->surfaces);
+    free(wavefront->occluded);
+    free(wavefront->shadow_order);
+    free(wavefront->pixels);
+    if (wavefront->light_samples) destroy_ray_queue(&wavefront->light_rays);
+    free(wavefront->light_samples);
+    free(wavefront->light_offsets);
+    free(wavefront->light_occluded);
+    wavefront->surfaces = NULL;
+    wavefront->occluded = NULL;
+    wavefront->shadow_order = NULL;
+    wavefront->light_samples = NULL;
+    wavefront->light_offsets = NULL;
+    wavefront->light_occluded = NULL;
+    wavefront->pixels = NULL;
+    wavefront->pixel_capacity = 0;
+}
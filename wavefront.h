@@ -0,0 +1,60 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "scene.h"
+
+#define WAVEFRONT_WAVE_SIZE (1 << 16)  // Pixels in flight per wave, bounds the queue memory
+
+typedef enum {
+    WAVEFRONT_GENERATE,         // Camera rays for the dirty pixels of a wave
+    WAVEFRONT_EXTEND,           // Closest hits of the camera rays
+    WAVEFRONT_SHADE,            // Surface attributes, light samples and shadow rays
+    WAVEFRONT_SHADOW,           // Occlusion of the directional and local light shadow rays
+    WAVEFRONT_RESOLVE,          // Lighting and frame writes
+    WAVEFRONT_STAGE_COUNT
+} WavefrontStage;
+
+// Structure-of-arrays ray queue, hit fields are filled by the extend stage
+typedef struct {
+    size_t count;
+    size_t capacity;
+    int* pixels;                // Index of the pixel the ray belongs to
+    float* origin_x;
+    float* origin_y;
+    float* origin_z;
+    float* direction_x;
+    float* direction_y;
+    float* direction_z;
+    float* t;
+    float* u;
+    float* v;
+    int* mesh_index;            // -1 for misses
+    int* triangle_index;
+} RayQueue;
+
+typedef struct Wavefront {
+    RayQueue rays;
+    RayQueue shadow_rays;
+    SurfaceSample* surfaces;    // Parallel to shadow_rays
+    unsigned char* occluded;    // Parallel to shadow_rays
+    int* shadow_order;          // Shadow rays grouped by the mesh they start on
+    RayQueue light_rays;        // Point and spot light shadow rays, t holds the distance to the light
+    LocalLightSample* light_samples;    // LIGHT_SAMPLE_COUNT slots per entry of shadow_rays
+    int* light_offsets;         // First light ray of each shadow_rays entry, count + 1 entries
+    unsigned char* light_occluded;      // Parallel to light_rays
+    int* pixels;                // Dirty pixels of the current frame in tile order
+    size_t pixel_capacity;
+    bool sort_shadow_rays;
+    double stage_seconds[WAVEFRONT_STAGE_COUNT];
+    size_t stage_items[WAVEFRONT_STAGE_COUNT];
+    size_t batched_frames;      // Rendered frame-parallel without the queues, missing from the stage times
+} Wavefront;
+
+// Queue-based renderer, enabled with set_scene_wavefront
+Wavefront create_wavefront(bool sort_shadow_rays);
+void render_wavefront(Scene* scene, float aspect, unsigned char* current_frame,
+                      const unsigned char* previous_frame);
+void print_wavefront_stats(const Wavefront* wavefront);
+void destroy_wavefront(Wavefront* wavefront);
+
+#endif